@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include <headers/snake_state.hpp>
+#include <headers/MCTS.hpp>
+
+//plays a quick game until the snake covers a quarter of the board, gives the search a realistic position
+//	shared by snake_bench and snake_suite so both measure from the same kind of position
+inline SnakeState midgame_state(int width, int height, uint32_t seed) {
+	SnakeState snake_state = SnakeState::new_game(width, height, seed);
+	MCTS MCTS_instance(snake_state, 50, 10, int(seed));
+	for(int moves = 0; moves < 100 * snake_state.num_cells() && snake_state.length < snake_state.num_cells() / 4; moves++) {
+		int move_dir = MCTS_instance.run_MCTS();
+		if(move_dir == -1 || snake_state.move(move_dir) == MOVE_DIED) {
+			return SnakeState::new_game(width, height, seed);
+		}
+		MCTS_instance.update(snake_state, move_dir);
+	}
+
+	return snake_state;
+}
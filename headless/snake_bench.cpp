@@ -0,0 +1,185 @@
+// Search throughput benchmark
+// measures playouts per second for every rollout batch size and rollout policy, and MCTS iterations per second for every parallel mode from 1 to N threads
+// with --games, also the average score of full games at small iteration budgets with and without RAVE
+//	snake_bench --x 10 --y 10 --iterations 2000 --depth 100 --seed 1 --threads 8 [--games 16 --rave 10]
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include <headers/snake_state.hpp>
+#include <headers/playout.hpp>
+#include <headers/MCTS.hpp>
+
+#include "bench_positions.hpp"
+
+// Namespaces
+using namespace std;
+
+struct BenchOptions {
+	int grid_x = 10;
+	int grid_y = 10;
+	int iterations = 2000;
+	int depth = 100;
+	int seed = 1;
+	int threads = 0; //0 uses every hardware thread
+	int repeats = 5;
+	int games = 0; //seeded games per iteration budget in the RAVE comparison, 0 skips it
+	int rave = MCTS::DEFAULT_RAVE_EQUIVALENCE;
+};
+
+static void print_usage() {
+	cout << "usage: snake_bench [--x N] [--y N] [--iterations N] [--depth N] [--seed N] [--threads N] [--repeats N] [--games N] [--rave N]" << endl;
+}
+
+static bool parse_options(int argc, char** argv, BenchOptions& options) {
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if(arg == "--help" || arg == "-h" || i + 1 >= argc) {
+			return false;
+		}
+
+		int value = atoi(argv[++i]);
+		if     (arg == "--x")          options.grid_x = value;
+		else if(arg == "--y")          options.grid_y = value;
+		else if(arg == "--iterations") options.iterations = value;
+		else if(arg == "--depth")      options.depth = value;
+		else if(arg == "--seed")       options.seed = value;
+		else if(arg == "--threads")    options.threads = value;
+		else if(arg == "--repeats")    options.repeats = value;
+		else if(arg == "--games")      options.games = value;
+		else if(arg == "--rave")       options.rave = value;
+		else return false;
+	}
+
+	return options.grid_x >= 2 && options.grid_x <= MAX_BOARD_SIDE &&
+	       options.grid_y >= 2 && options.grid_y <= MAX_BOARD_SIDE;
+}
+
+//plays options.iterations playouts from snake_state, batch_size games at a time
+static PlayoutStats playout_rate(const BenchOptions& options, const SnakeState& snake_state, int batch_size, RolloutPolicy policy, double& seconds) {
+	PlayoutEngine playout(snake_state.width, snake_state.height);
+	playout.set_policy(policy);
+	mt19937 rng(options.seed);
+	SnakeState states[MAX_PLAYOUT_BATCH];
+
+	PlayoutStats stats;
+	auto start_time = chrono::steady_clock::now();
+	for(int i = 0; i < options.repeats * options.iterations; i += batch_size) {
+		for(int lane = 0; lane < batch_size; lane++) {
+			states[lane] = snake_state;
+			states[lane].use_simulated_fruit(rng());
+		}
+
+		stats.steps += (batch_size == 1) ? playout.play(states[0], options.depth, rng) : playout.play_batch(states, batch_size, options.depth, rng);
+		stats.playouts += batch_size;
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+	return stats;
+}
+
+static double iterations_per_second(const BenchOptions& options, const SnakeState& snake_state, int num_threads, ParallelMode mode) {
+	MCTS MCTS_instance(snake_state, options.iterations, options.depth, options.seed);
+	MCTS_instance.set_parallel(num_threads, mode);
+
+	auto start_time = chrono::steady_clock::now();
+	for(int i = 0; i < options.repeats; i++) {
+		MCTS_instance.run_MCTS();
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+	return double(options.iterations) * options.repeats / seconds;
+}
+
+//average final score of options.games seeded games, every move searches exactly iterations iterations
+static double average_score(const BenchOptions& options, int iterations, int rave_equivalence, int& games_won) {
+	int num_cells = options.grid_x * options.grid_y;
+	double total_score = 0;
+	games_won = 0;
+	for(int game = 0; game < options.games; game++) {
+		uint32_t seed = options.seed + game;
+		SnakeState snake_state = SnakeState::new_game(options.grid_x, options.grid_y, seed);
+		MCTS MCTS_instance(snake_state, iterations, options.depth, int(seed));
+		MCTS_instance.set_rave(rave_equivalence);
+		for(int moves = 0; moves < 4 * num_cells * num_cells && !snake_state.is_terminal() && !snake_state.is_max_length(); moves++) {
+			int move_dir = MCTS_instance.run_MCTS();
+			snake_state.move(move_dir);
+			MCTS_instance.update(snake_state, move_dir);
+		}
+
+		total_score += snake_state.length;
+		games_won += snake_state.is_max_length();
+	}
+
+	return total_score / max(1, options.games);
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	if(!parse_options(argc, argv, options)) {
+		print_usage();
+		return 1;
+	}
+
+	int max_threads = (options.threads > 0) ? options.threads : max(1u, thread::hardware_concurrency());
+	SnakeState snake_state = midgame_state(options.grid_x, options.grid_y, options.seed);
+	cout << "board=" << options.grid_x << "x" << options.grid_y
+	     << " snake_length=" << snake_state.length
+	     << " iterations=" << options.iterations
+	     << " depth=" << options.depth << endl;
+
+	for(int batch_size : {1, 4, 8, 16}) {
+		double seconds;
+		PlayoutStats stats = playout_rate(options, snake_state, batch_size, ROLLOUT_UNIFORM, seconds);
+		cout << "playout batch=" << batch_size
+		     << " playouts/s=" << stats.playouts / seconds
+		     << " steps/s=" << stats.steps / seconds << endl;
+	}
+
+	const pair<const char*, RolloutPolicy> policies[] = {{"uniform", ROLLOUT_UNIFORM}, {"greedy", ROLLOUT_GREEDY}, {"hamiltonian", ROLLOUT_HAMILTONIAN}, {"tail", ROLLOUT_TAIL_CHASE}};
+	for(const auto& policy : policies) {
+		double seconds;
+		PlayoutStats stats = playout_rate(options, snake_state, 1, policy.second, seconds);
+		cout << "playout policy=" << policy.first
+		     << " playouts/s=" << stats.playouts / seconds
+		     << " steps/s=" << stats.steps / seconds
+		     << " steps/playout=" << double(stats.steps) / stats.playouts << endl;
+	}
+
+	const pair<const char*, ParallelMode> modes[] = {{"root", PARALLEL_ROOT}, {"tree", PARALLEL_TREE}, {"lockfree", PARALLEL_LOCK_FREE}};
+	for(const auto& mode : modes) {
+		double baseline = 0;
+		for(int num_threads = 1; num_threads <= max_threads; num_threads++) {
+			double rate = iterations_per_second(options, snake_state, num_threads, mode.second);
+			if(num_threads == 1) {
+				baseline = rate;
+			}
+
+			cout << "mode=" << mode.first
+			     << " threads=" << num_threads
+			     << " iterations/s=" << rate
+			     << " speedup=" << rate / baseline << endl;
+		}
+	}
+
+	//the budgets a search gets inside one game tick, where UCT alone has the fewest visits to tell the moves apart
+	if(options.games > 0) {
+		for(int iterations : {25, 50, 100, 200}) {
+			for(int rave_equivalence : {0, options.rave}) {
+				int games_won;
+				double score = average_score(options, iterations, rave_equivalence, games_won);
+				cout << "convergence iterations=" << iterations
+				     << " rave=" << rave_equivalence
+				     << " avg_score=" << score
+				     << " won=" << games_won << endl;
+				if(options.rave == 0) {
+					break;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
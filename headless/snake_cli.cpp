@@ -0,0 +1,242 @@
+// Headless snake driver
+// plays full MCTS games without Godot, takes the same knobs start_game reads from the ui
+//	snake_cli --x 10 --y 10 --iterations 100 --depth 100 --seed 1 --games 5 [--threads 4 --parallel tree] [--time_ms 100 | --ponder_ms 100]
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <thread>
+
+#include <headers/snake_state.hpp>
+#include <headers/MCTS.hpp>
+
+// Namespaces
+using namespace std;
+
+struct CliOptions {
+	int grid_x = 10;
+	int grid_y = 10;
+	int iterations = 100;
+	int depth = 100;
+	int64_t seed = -1; //-1 picks a random seed
+	int games = 1;
+	int max_moves = 0; //0 derives a move cap from the board size
+	int stall_moves = 0; //moves without eating before the game is cut off, 0 derives it from the board size
+	int threads = 1;
+	int max_nodes = MCTS::DEFAULT_MAX_NODES;
+	int tree_mb = 0; //tree memory cap in MiB, replaces max_nodes when set
+	int time_ms = 0; //per move search deadline, 0 searches the full iteration count
+	RolloutPolicy policy = ROLLOUT_UNIFORM;
+	TrapPruning traps = TRAPS_OFF;
+	int rollout_traps = 0; //1 also prunes traps in every playout step
+	int state_cache = 1; //0 replays every descent from the root state
+	int endgame = MCTS::DEFAULT_ENDGAME_CELLS; //free cells at or below which the endgame solver runs, 0 disables it
+	int rave = 0; //RAVE equivalence in visits, 0 disables it
+	int batch = 1; //leaves rolled out together per thread
+	int tt_mb = 0; //transposition table cap in MiB, 0 disables it
+	int ponder_ms = 0; //game tick length, the search runs in the background while the driver waits like the game timer
+	ParallelMode parallel_mode = PARALLEL_ROOT;
+};
+
+static void print_usage() {
+	cout << "usage: snake_cli [--x N] [--y N] [--iterations N] [--depth N] [--seed N] [--games N] [--max_moves N] [--stall_moves N] [--threads N] [--parallel root|tree|lockfree] [--max_nodes N] [--tree_mb N] [--time_ms N] [--ponder_ms N] [--tt_mb N] [--batch N] [--policy uniform|greedy|hamiltonian|tail] [--traps off|prune|penalize] [--rollout_traps 0|1] [--state_cache 0|1] [--endgame N] [--rave N]" << endl;
+	cout << "  --time_ms stops every search at the deadline, --iterations stays a cap unless it is 0" << endl;
+	cout << "  --stall_moves ends a game that has not eaten for N moves, a policy can circle forever without dying" << endl;
+	cout << "  --ponder_ms searches in the background during a tick of N ms and collects the result at the end of it" << endl;
+}
+
+static bool parse_options(int argc, char** argv, CliOptions& options) {
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if(arg == "--help" || arg == "-h" || i + 1 >= argc) {
+			return false;
+		}
+
+		if(arg == "--parallel") {
+			string mode = argv[++i];
+			if     (mode == "root") options.parallel_mode = PARALLEL_ROOT;
+			else if(mode == "tree") options.parallel_mode = PARALLEL_TREE;
+			else if(mode == "lockfree") options.parallel_mode = PARALLEL_LOCK_FREE;
+			else return false;
+			continue;
+		}
+		if(arg == "--policy") {
+			string policy = argv[++i];
+			if     (policy == "uniform") options.policy = ROLLOUT_UNIFORM;
+			else if(policy == "greedy") options.policy = ROLLOUT_GREEDY;
+			else if(policy == "hamiltonian") options.policy = ROLLOUT_HAMILTONIAN;
+			else if(policy == "tail") options.policy = ROLLOUT_TAIL_CHASE;
+			else return false;
+			continue;
+		}
+		if(arg == "--traps") {
+			string mode = argv[++i];
+			if     (mode == "off") options.traps = TRAPS_OFF;
+			else if(mode == "prune") options.traps = TRAPS_PRUNE;
+			else if(mode == "penalize") options.traps = TRAPS_PENALIZE;
+			else return false;
+			continue;
+		}
+
+		long long value = strtoll(argv[++i], nullptr, 10);
+		if     (arg == "--x")          options.grid_x = value;
+		else if(arg == "--y")          options.grid_y = value;
+		else if(arg == "--iterations") options.iterations = value;
+		else if(arg == "--depth")      options.depth = value;
+		else if(arg == "--seed")       options.seed = value;
+		else if(arg == "--games")      options.games = value;
+		else if(arg == "--max_moves")  options.max_moves = value;
+		else if(arg == "--stall_moves") options.stall_moves = value;
+		else if(arg == "--threads")    options.threads = value;
+		else if(arg == "--max_nodes")  options.max_nodes = value;
+		else if(arg == "--tree_mb")    options.tree_mb = value;
+		else if(arg == "--time_ms")    options.time_ms = value;
+		else if(arg == "--ponder_ms")  options.ponder_ms = value;
+		else if(arg == "--tt_mb")      options.tt_mb = value;
+		else if(arg == "--batch")      options.batch = value;
+		else if(arg == "--rollout_traps") options.rollout_traps = value;
+		else if(arg == "--state_cache") options.state_cache = value;
+		else if(arg == "--endgame")    options.endgame = value;
+		else if(arg == "--rave")       options.rave = value;
+		else return false;
+	}
+
+	return options.grid_x >= 2 && options.grid_x <= MAX_BOARD_SIDE &&
+	       options.grid_y >= 2 && options.grid_y <= MAX_BOARD_SIDE;
+}
+
+int main(int argc, char** argv) {
+	CliOptions options;
+	if(!parse_options(argc, argv, options)) {
+		print_usage();
+		return 1;
+	}
+
+	uint32_t first_seed = (options.seed == -1) ? random_device{}() : uint32_t(options.seed);
+	int num_cells = options.grid_x * options.grid_y;
+	int max_moves = (options.max_moves > 0) ? options.max_moves : 4 * num_cells * num_cells;
+	int stall_moves = (options.stall_moves > 0) ? options.stall_moves : 4 * num_cells; //following the Hamiltonian cycle eats within num_cells moves
+
+	double total_score = 0;
+	double total_seconds = 0;
+	long long total_moves = 0;
+	long long total_iterations = 0;
+	int games_won = 0;
+	for(int game = 0; game < options.games; game++) {
+		uint32_t seed = first_seed + game;
+
+		//same setup as start_game, fruit and MCTS share the seed
+		SnakeState snake_state = SnakeState::new_game(options.grid_x, options.grid_y, seed);
+		MCTS MCTS_instance(snake_state, options.iterations, options.depth, int(seed), sqrt(2), options.policy);
+		if(options.tree_mb > 0) {
+			MCTS_instance.set_max_bytes(size_t(options.tree_mb) << 20);
+		}
+		else {
+			MCTS_instance.set_max_nodes(options.max_nodes);
+		}
+		MCTS_instance.set_transposition_table(size_t(options.tt_mb) << 20);
+		MCTS_instance.set_rollout_batch(options.batch);
+		MCTS_instance.set_trap_pruning(options.traps, options.rollout_traps != 0);
+		MCTS_instance.set_state_cache(options.state_cache != 0);
+		MCTS_instance.set_endgame_solver(options.endgame);
+		MCTS_instance.set_rave(options.rave);
+		MCTS_instance.set_parallel(options.threads, options.parallel_mode);
+
+		auto start_time = chrono::steady_clock::now();
+		int moves = 0;
+		int last_eat_move = 0;
+		long long iterations = 0;
+		int solved_moves = 0; //moves played from a root the solver had decided
+		double blocked_seconds = 0; //time the driver spends waiting on the search, the game's main thread cost
+		if(options.ponder_ms > 0) {
+			MCTS_instance.start_pondering(options.iterations);
+		}
+		while(!snake_state.is_terminal() && !snake_state.is_max_length() && moves < max_moves && moves - last_eat_move < stall_moves) {
+			if(options.ponder_ms > 0) {
+				this_thread::sleep_for(chrono::milliseconds(options.ponder_ms));
+			}
+
+			auto search_start_time = chrono::steady_clock::now();
+			SearchResult search_result = (options.ponder_ms > 0) ? MCTS_instance.collect() : MCTS_instance.run_MCTS(options.time_ms / 1000.0, options.iterations);
+			int move_dir = search_result.action;
+			iterations += search_result.iterations;
+			solved_moves += MCTS_instance.get_root_proof() != PROOF_NONE;
+			int length = snake_state.length;
+			snake_state.move(move_dir);
+			MCTS_instance.update(snake_state, move_dir);
+			if(options.ponder_ms > 0) {
+				MCTS_instance.start_pondering(options.iterations);
+			}
+			blocked_seconds += chrono::duration<double>(chrono::steady_clock::now() - search_start_time).count();
+			moves++;
+			if(snake_state.length > length) {
+				last_eat_move = moves;
+			}
+		}
+		MCTS_instance.collect();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+		PlayoutStats playout_stats = MCTS_instance.get_playout_stats();
+		TreeStats tree_stats = MCTS_instance.get_tree_stats();
+
+		const char* result = snake_state.is_max_length() ? "won" : (snake_state.is_terminal() ? "lost" : ((moves < max_moves) ? "stalled" : "move_cap"));
+		games_won += snake_state.is_max_length();
+		total_score += snake_state.length;
+		total_seconds += seconds;
+		total_moves += moves;
+		total_iterations += iterations;
+
+		cout << "seed=" << seed
+		     << " score=" << snake_state.length
+		     << " moves=" << moves
+		     << " result=" << result
+		     << " time=" << seconds << "s"
+		     << " moves/s=" << moves / seconds
+		     << " iterations/move=" << double(iterations) / max(1, moves)
+		     << " blocked_ms/move=" << 1000 * blocked_seconds / max(1, moves)
+		     << " iterations/s=" << iterations / seconds
+		     << " playouts/s=" << playout_stats.playouts / seconds
+		     << " steps/s=" << playout_stats.steps / seconds
+		     << " steps/playout=" << double(playout_stats.steps) / max<uint64_t>(1, playout_stats.playouts)
+		     << " live_nodes=" << tree_stats.live_nodes
+		     << " high_water_nodes=" << tree_stats.high_water_nodes
+		     << " pruned_nodes=" << tree_stats.pruned_nodes
+		     << " solved_moves=" << solved_moves
+		     << " tree_mb=" << tree_stats.bytes / double(1 << 20);
+		if(options.endgame > 0) {
+			EndgameStats endgame_stats = MCTS_instance.get_endgame_stats();
+			cout << " endgame_solves=" << endgame_stats.solves
+			     << " endgame_wins=" << endgame_stats.wins
+			     << " endgame_losses=" << endgame_stats.losses
+			     << " endgame_nodes/solve=" << double(endgame_stats.nodes) / max<uint64_t>(1, endgame_stats.solves);
+		}
+		if(options.tt_mb > 0) {
+			TTStats tt_stats = MCTS_instance.get_transposition_stats();
+			cout << " tt_hit_rate=" << tt_stats.hit_rate()
+			     << " tt_replacements=" << tt_stats.replacements
+			     << " tt_mb=" << tt_stats.bytes / double(1 << 20);
+		}
+#ifdef MCTS_STATS
+		SearchStats search_stats = MCTS_instance.get_search_stats();
+		cout << " selection_ms=" << search_stats.selection_ns / 1e6
+		     << " expansion_ms=" << search_stats.expansion_ns / 1e6
+		     << " rollout_ms=" << search_stats.rollout_ns / 1e6
+		     << " backpropagation_ms=" << search_stats.backpropagation_ns / 1e6
+		     << " mean_depth=" << search_stats.mean_depth()
+		     << " max_depth=" << search_stats.max_depth
+		     << " terminal_hits=" << search_stats.terminal_hits
+		     << " nodes_created=" << search_stats.nodes_created
+		     << " branching_factor=" << search_stats.branching_factor()
+		     << " rollout_length=" << search_stats.mean_rollout_length();
+#endif
+		cout << endl;
+	}
+
+	cout << "games=" << options.games
+	     << " won=" << games_won
+	     << " avg_score=" << total_score / options.games
+	     << " moves/s=" << total_moves / total_seconds
+	     << " iterations/s=" << total_iterations / total_seconds << endl;
+
+	return 0;
+}
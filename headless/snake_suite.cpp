@@ -0,0 +1,378 @@
+// Benchmark suite
+// micro benchmarks of the simulator and the search steps, then the seeded games of test_cases played to completion
+// results are printed one per line and written as JSON with --json, compare two files to catch regressions in throughput and score
+//	snake_suite --json results.json [--filter run_MCTS] [--min_time 0.5] [--games 5 --x 10 --y 10 --iterations 1000 --depth 2]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <random>
+#include <thread>
+#include <cstdlib>
+
+#include <headers/snake_state.hpp>
+#include <headers/playout.hpp>
+#include <headers/distance_field.hpp>
+#include <headers/MCTS.hpp>
+
+#include "bench_positions.hpp"
+
+// Namespaces
+using namespace std;
+
+//defaults replay the parameters of the test_cases screenshots: seeds 1 to 5 on a 10x10 board, 1000 iterations, depth 2
+struct SuiteOptions {
+	int grid_x = 10;
+	int grid_y = 10;
+	int iterations = 1000;
+	int depth = 2;
+	int games = 5; //seeded games played to completion, seeds 1 to games, 0 skips them
+	double min_time = 0.5; //seconds every micro benchmark runs at least
+	string filter; //only benchmarks whose name contains it, empty runs all of them
+	string json_path; //empty prints no JSON
+};
+
+struct BenchmarkResult {
+	string name;
+	uint64_t iterations; //calls of the benchmarked operation
+	double seconds;
+	double items; //work items done, iterations unless an operation does several
+};
+
+struct GameResult {
+	uint32_t seed;
+	int score;
+	int moves;
+	const char* result;
+	double seconds;
+	long long iterations;
+};
+
+static volatile uint64_t sink; //keeps benchmarked results alive
+
+static void print_usage() {
+	cout << "usage: snake_suite [--json FILE] [--filter TEXT] [--min_time SECONDS] [--games N] [--x N] [--y N] [--iterations N] [--depth N]" << endl;
+}
+
+static bool parse_options(int argc, char** argv, SuiteOptions& options) {
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if(arg == "--help" || arg == "-h" || i + 1 >= argc) {
+			return false;
+		}
+
+		string value = argv[++i];
+		if     (arg == "--json")       options.json_path = value;
+		else if(arg == "--filter")     options.filter = value;
+		else if(arg == "--min_time")   options.min_time = atof(value.c_str());
+		else if(arg == "--games")      options.games = atoi(value.c_str());
+		else if(arg == "--x")          options.grid_x = atoi(value.c_str());
+		else if(arg == "--y")          options.grid_y = atoi(value.c_str());
+		else if(arg == "--iterations") options.iterations = atoi(value.c_str());
+		else if(arg == "--depth")      options.depth = atoi(value.c_str());
+		else return false;
+	}
+
+	return options.grid_x >= 2 && options.grid_x <= MAX_BOARD_SIDE &&
+	       options.grid_y >= 2 && options.grid_y <= MAX_BOARD_SIDE;
+}
+
+//runs body(n) with a growing n until one run lasts min_time, body returns the work items it did
+//	the first runs warm caches and the branch predictor, only the last one is reported
+template<class Body>
+static BenchmarkResult run_benchmark(const string& name, double min_time, Body body) {
+	uint64_t iterations = 1;
+	while(true) {
+		auto start_time = chrono::steady_clock::now();
+		double items = body(iterations);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+		if(seconds >= min_time || iterations >= (uint64_t(1) << 40)) {
+			return {name, iterations, seconds, items};
+		}
+
+		//aim 40% past min_time, at most ten times more iterations per step
+		double scale = (seconds > 0) ? 1.4 * min_time / seconds : 10;
+		iterations = uint64_t(iterations * min(10.0, max(2.0, scale)));
+	}
+}
+
+//uniformly random set bit of a non-empty move mask
+static int random_move(int moves, mt19937& rng) {
+	int skip = uniform_int_distribution<int>(0, bit_count(moves) - 1)(rng);
+	for(; skip > 0; skip--) {
+		moves &= moves - 1;
+	}
+
+	return lowest_bit(moves);
+}
+
+//positions along a random game, enough different ones that a benchmark does not run on one cached state
+static vector<SnakeState> sample_states(const SuiteOptions& options, int count) {
+	mt19937 rng(1);
+	vector<SnakeState> states;
+	SnakeState snake_state = SnakeState::new_game(options.grid_x, options.grid_y, 1);
+	while(int(states.size()) < count) {
+		int moves = snake_state.legal_moves();
+		if(moves == 0 || snake_state.is_max_length()) {
+			snake_state = SnakeState::new_game(options.grid_x, options.grid_y, rng());
+			continue;
+		}
+		snake_state.move(random_move(moves, rng));
+		states.push_back(snake_state);
+	}
+
+	return states;
+}
+
+//private search steps of MCTS
+class MCTSBenchmark {
+public:
+	static double evaluate_state(MCTS& MCTS_instance, const SnakeState& start_state, const SnakeState& end_state) {
+		return MCTS_instance.evaluate_state(start_state, end_state);
+	}
+
+	static uint32_t selection(MCTS& MCTS_instance, mt19937& rng, SnakeState& leaf_state) {
+		return MCTS_instance.selection(rng, leaf_state, MCTS_instance.state_caches[0]);
+	}
+
+	static void reset_tree(MCTS& MCTS_instance, const SnakeState& snake_state) {
+		MCTS_instance.reset_tree(snake_state);
+	}
+};
+
+static vector<BenchmarkResult> run_micro_benchmarks(const SuiteOptions& options) {
+	vector<BenchmarkResult> results;
+	auto is_selected = [&](const string& name) { return name.find(options.filter) != string::npos; };
+	auto report = [&](const BenchmarkResult& result) {
+		cout << result.name
+		     << " iterations=" << result.iterations
+		     << " ns/op=" << 1e9 * result.seconds / result.iterations
+		     << " items/s=" << result.items / result.seconds << endl;
+		results.push_back(result);
+	};
+
+	const int NUM_STATES = 256;
+	vector<SnakeState> states = sample_states(options, NUM_STATES);
+	SnakeState midgame = midgame_state(options.grid_x, options.grid_y, 1);
+
+	//one move of a live game, random legal moves, a new game once the snake has no move left
+	if(is_selected("move")) {
+		report(run_benchmark("move", options.min_time, [&](uint64_t n) {
+			mt19937 rng(1);
+			SnakeState snake_state = states[0];
+			snake_state.use_simulated_fruit(rng());
+			for(uint64_t i = 0; i < n; i++) {
+				int moves = snake_state.legal_moves();
+				if(moves == 0 || snake_state.is_max_length()) {
+					snake_state = states[i % NUM_STATES];
+					snake_state.use_simulated_fruit(rng());
+					continue;
+				}
+				snake_state.move(random_move(moves, rng));
+			}
+			sink = snake_state.hash;
+			return double(n);
+		}));
+	}
+
+	if(is_selected("legal_moves")) {
+		report(run_benchmark("legal_moves", options.min_time, [&](uint64_t n) {
+			uint64_t total = 0;
+			for(uint64_t i = 0; i < n; i++) {
+				total += states[i % NUM_STATES].legal_moves();
+			}
+			sink = total;
+			return double(n);
+		}));
+	}
+
+	if(is_selected("playout_legal_moves")) {
+		PlayoutEngine playout(options.grid_x, options.grid_y);
+		report(run_benchmark("playout_legal_moves", options.min_time, [&](uint64_t n) {
+			uint64_t total = 0;
+			for(uint64_t i = 0; i < n; i++) {
+				total += playout.legal_moves(states[i % NUM_STATES]);
+			}
+			sink = total;
+			return double(n);
+		}));
+	}
+
+	//one rebuild of the fruit distances, done by the search on every new root
+	if(is_selected("distance_field")) {
+		DistanceField field(options.grid_x, options.grid_y);
+		report(run_benchmark("distance_field", options.min_time, [&](uint64_t n) {
+			uint64_t total = 0;
+			for(uint64_t i = 0; i < n; i++) {
+				const SnakeState& snake_state = states[i % NUM_STATES];
+				field.build(snake_state);
+				total += field.distance(snake_state.head(), snake_state.fruit);
+			}
+			sink = total;
+			return double(n);
+		}));
+	}
+
+	if(is_selected("evaluate_state")) {
+		MCTS MCTS_instance(midgame, options.iterations, options.depth, 1);
+		report(run_benchmark("evaluate_state", options.min_time, [&](uint64_t n) {
+			double total = 0;
+			for(uint64_t i = 0; i < n; i++) {
+				total += MCTSBenchmark::evaluate_state(MCTS_instance, states[i % NUM_STATES], states[(i + 1) % NUM_STATES]);
+			}
+			sink = uint64_t(total);
+			return double(n);
+		}));
+	}
+
+	//one descent from the root of a searched tree to a leaf
+	if(is_selected("selection")) {
+		MCTS MCTS_instance(midgame, 10 * options.iterations, options.depth, 1);
+		MCTS_instance.run_MCTS();
+		report(run_benchmark("selection", options.min_time, [&](uint64_t n) {
+			mt19937 rng(1);
+			SnakeState leaf_state;
+			uint64_t total = 0;
+			for(uint64_t i = 0; i < n; i++) {
+				total += MCTSBenchmark::selection(MCTS_instance, rng, leaf_state);
+			}
+			sink = total;
+			return double(n);
+		}));
+	}
+
+	//full searches from the midgame position on a fresh tree, items are search iterations
+	//	the instance is built once outside the timed loop, only the tree is reset between searches
+	vector<int> budgets = {100};
+	if(options.iterations != 100) {
+		budgets.push_back(options.iterations);
+	}
+	for(int iterations : budgets) {
+		string name = "run_MCTS/iterations:" + to_string(iterations);
+		if(is_selected(name)) {
+			MCTS MCTS_instance(midgame, iterations, options.depth, 1);
+			report(run_benchmark(name, options.min_time, [&](uint64_t n) {
+				uint64_t total = 0;
+				for(uint64_t i = 0; i < n; i++) {
+					MCTSBenchmark::reset_tree(MCTS_instance, midgame);
+					total += MCTS_instance.run_MCTS();
+				}
+				sink = total;
+				return double(n) * iterations;
+			}));
+		}
+	}
+
+	return results;
+}
+
+//same setup as start_game, the seed drives the fruit and the search, every move searches the full iteration count instead of pondering for a tick
+static vector<GameResult> run_games(const SuiteOptions& options) {
+	vector<GameResult> results;
+	int num_cells = options.grid_x * options.grid_y;
+	for(int game = 1; game <= options.games; game++) {
+		uint32_t seed = game;
+		SnakeState snake_state = SnakeState::new_game(options.grid_x, options.grid_y, seed);
+		MCTS MCTS_instance(snake_state, options.iterations, options.depth, int(seed));
+		MCTS_instance.set_transposition_table(MCTS::DEFAULT_TT_BYTES);
+
+		auto start_time = chrono::steady_clock::now();
+		int moves = 0;
+		long long iterations = 0;
+		while(!snake_state.is_terminal() && !snake_state.is_max_length() && moves < 4 * num_cells * num_cells) {
+			SearchResult search_result = MCTS_instance.run_MCTS(0, options.iterations);
+			iterations += search_result.iterations;
+			snake_state.move(search_result.action);
+			MCTS_instance.update(snake_state, search_result.action);
+			moves++;
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+		const char* result = snake_state.is_max_length() ? "won" : (snake_state.is_terminal() ? "lost" : "move_cap");
+		results.push_back({seed, snake_state.length, moves, result, seconds, iterations});
+		cout << "game seed=" << seed
+		     << " score=" << snake_state.length
+		     << " moves=" << moves
+		     << " result=" << result
+		     << " time=" << seconds << "s"
+		     << " iterations/s=" << iterations / seconds << endl;
+	}
+
+	return results;
+}
+
+//layout follows Google Benchmark's JSON output, games are an extra array
+static string to_json(const SuiteOptions& options, const vector<BenchmarkResult>& benchmarks, const vector<GameResult>& games) {
+	ostringstream json;
+	json.precision(10);
+
+	char date[32];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	json << "{\n"
+	     << "  \"context\": {\n"
+	     << "    \"date\": \"" << date << "\",\n"
+	     << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+	     << "    \"library_build_type\": \"release\",\n"
+#else
+	     << "    \"library_build_type\": \"debug\",\n"
+#endif
+	     << "    \"board\": \"" << options.grid_x << "x" << options.grid_y << "\",\n"
+	     << "    \"iterations\": " << options.iterations << ",\n"
+	     << "    \"depth\": " << options.depth << "\n"
+	     << "  },\n";
+
+	json << "  \"benchmarks\": [";
+	for(size_t i = 0; i < benchmarks.size(); i++) {
+		const BenchmarkResult& result = benchmarks[i];
+		json << (i ? ",\n" : "\n")
+		     << "    {\"name\": \"" << result.name << "\""
+		     << ", \"iterations\": " << result.iterations
+		     << ", \"real_time\": " << 1e9 * result.seconds / result.iterations
+		     << ", \"time_unit\": \"ns\""
+		     << ", \"items_per_second\": " << result.items / result.seconds << "}";
+	}
+	json << (benchmarks.empty() ? "],\n" : "\n  ],\n");
+
+	json << "  \"games\": [";
+	for(size_t i = 0; i < games.size(); i++) {
+		const GameResult& result = games[i];
+		json << (i ? ",\n" : "\n")
+		     << "    {\"seed\": " << result.seed
+		     << ", \"score\": " << result.score
+		     << ", \"moves\": " << result.moves
+		     << ", \"result\": \"" << result.result << "\""
+		     << ", \"seconds\": " << result.seconds
+		     << ", \"iterations_per_second\": " << result.iterations / result.seconds << "}";
+	}
+	json << (games.empty() ? "]\n" : "\n  ]\n");
+	json << "}\n";
+
+	return json.str();
+}
+
+int main(int argc, char** argv) {
+	SuiteOptions options;
+	if(!parse_options(argc, argv, options)) {
+		print_usage();
+		return 1;
+	}
+
+	vector<BenchmarkResult> benchmarks = run_micro_benchmarks(options);
+	vector<GameResult> games = run_games(options);
+
+	if(!options.json_path.empty()) {
+		ofstream file(options.json_path);
+		file << to_json(options, benchmarks, games);
+		if(!file) {
+			cerr << "cannot write " << options.json_path << endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -1,365 +1,1462 @@
-// Godot SDK
-#include <Godot/godot.hpp>
 #include <iostream>
 #include <vector>
 #include <cmath>
 #include <functional>
 #include <memory>
 #include <random>
-#include <Godot/variant/array.hpp>
-#include <Godot/variant/utility_functions.hpp>
+#include <limits>
+#include <algorithm>
+#include <new>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
-// Jenova SDK
-#include <JenovaSDK.h>
-#include <headers/snake_functions.hpp>
+#include <headers/snake_state.hpp>
+#include <headers/thread_pool.hpp>
+#include <headers/atomic_utils.hpp>
+#include <headers/arena.hpp>
+#include <headers/transposition_table.hpp>
+#include <headers/playout.hpp>
+#include <headers/reachability.hpp>
+#include <headers/distance_field.hpp>
 #include <headers/MCTS.hpp>
 
 // Namespaces
-using namespace godot;
-using namespace jenova::sdk;
 using namespace std;
 
-MCTS::MCTS(Array snake_matrix, int max_iterations, int max_rollout_depth, int gen_seed, double exploration_constant)
-	:   root(make_shared<Node>(nullptr, snake_matrix)), //initialize root
+//search instrumentation, every statement compiles away without MCTS_STATS
+#ifdef MCTS_STATS
+//adds the lifetime of a scope to a phase timer
+struct PhaseTimer {
+	atomic<uint64_t>& counter;
+	chrono::steady_clock::time_point start_time;
+
+	PhaseTimer(atomic<uint64_t>& counter) : counter(counter), start_time(chrono::steady_clock::now()) {}
+	~PhaseTimer() { counter.fetch_add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_time).count(), memory_order_relaxed); }
+};
+
+#define MCTS_STATS_TIMER(phase) PhaseTimer phase_timer(search_counters.phase)
+#define MCTS_STATS_ADD(counter, amount) search_counters.counter.fetch_add(amount, memory_order_relaxed)
+#define MCTS_STATS_RECORD_SELECTION(leaf, leaf_state) record_selection(leaf, leaf_state)
+#else
+#define MCTS_STATS_TIMER(phase)
+#define MCTS_STATS_ADD(counter, amount)
+#define MCTS_STATS_RECORD_SELECTION(leaf, leaf_state)
+#endif
+
+//log(n) for small visit counts, selection takes the log of the parent visits at every level
+static double cached_log(int n) {
+	static const vector<double> log_table = [] {
+		vector<double> table(4096);
+		for(int i = 0; i < int(table.size()); i++) {
+			table[i] = log(i);
+		}
+		return table;
+	}();
+
+	return (n >= 0 && n < int(log_table.size())) ? log_table[n] : log(n);
+}
+
+//bit mask of the children with the highest UCT (Upper Confidence bounds applied to Trees) value
+//	unvisited children are prioritized, lanes past count never win
+//	AVX2 scores all four children at once, the scalar fallback computes the same values
+static uint32_t best_UCT_children(const double* visits, const double* rewards, int count, double log_parent_visits, double exploration_constant) {
+	const double infinity = numeric_limits<double>::infinity();
+
+#ifdef __AVX2__
+	uint32_t count_mask = (1u << count) - 1;
+	__m256d child_visits = _mm256_loadu_pd(visits);
+	__m256d exploitation = _mm256_div_pd(_mm256_loadu_pd(rewards), child_visits);
+	__m256d exploration = _mm256_sqrt_pd(_mm256_div_pd(_mm256_set1_pd(log_parent_visits), child_visits));
+	__m256d UCT = _mm256_add_pd(exploitation, _mm256_mul_pd(_mm256_set1_pd(exploration_constant), exploration));
+
+	UCT = _mm256_blendv_pd(UCT, _mm256_set1_pd(infinity), _mm256_cmp_pd(child_visits, _mm256_setzero_pd(), _CMP_EQ_OQ));
+	__m256d lanes = _mm256_set_pd(3, 2, 1, 0);
+	UCT = _mm256_blendv_pd(UCT, _mm256_set1_pd(-infinity), _mm256_cmp_pd(lanes, _mm256_set1_pd(count), _CMP_GE_OQ));
+
+	//horizontal max, then every lane equal to it is a candidate
+	__m256d best_UCT = _mm256_max_pd(UCT, _mm256_permute_pd(UCT, 0x5));
+	best_UCT = _mm256_max_pd(best_UCT, _mm256_permute2f128_pd(best_UCT, best_UCT, 0x1));
+	uint32_t best_mask = _mm256_movemask_pd(_mm256_cmp_pd(UCT, best_UCT, _CMP_EQ_OQ)) & count_mask;
+#else
+	double UCT[4];
+	double best_UCT = -infinity;
+	for(int i = 0; i < count; i++) {
+		if(visits[i] == 0) {
+			UCT[i] = infinity;
+		}
+		else {
+			double exploitation = rewards[i] / visits[i];
+			double exploration = sqrt(log_parent_visits / visits[i]);
+			UCT[i] = exploitation + exploration_constant * exploration;
+		}
+		best_UCT = max(best_UCT, UCT[i]);
+	}
+
+	uint32_t best_mask = 0;
+	for(int i = 0; i < count; i++) {
+		best_mask |= uint32_t(UCT[i] == best_UCT) << i;
+	}
+#endif
+
+	//all values undefined, fall back to the first child
+	return best_mask ? best_mask : 1u;
+}
+
+MCTS::Node::Node(uint32_t parent, int child_slot, int action, uint64_t hash)
+	:   parent(parent), child_slot(child_slot), children(UNEXPANDED), is_chance(false), won_children(0), lost_children(0), is_exhaustive(false),
+		action(action), fruit_cell(-1), hash(hash) {
+	for(int i = 0; i < MAX_CHILD_SLOTS; i++) {
+		child_visits[i].store(0, memory_order_relaxed);
+		child_reward[i].store(0, memory_order_relaxed);
+		child_virtual_loss[i].store(0, memory_order_relaxed);
+	}
+}
+
+MCTS::ChildRange MCTS::Node::get_children() const {
+	uint64_t packed = children.load(memory_order_acquire);
+	return {uint32_t(packed), uint32_t(packed >> 32) & 0xffff, uint32_t(packed >> 48)};
+}
+
+void MCTS::Node::apply(SnakeState& state) const {
+	if(action == -1) {
+		state.place_fruit(fruit_cell);
+		return;
+	}
+
+	//the spawn that follows an eat is left to the outcomes of the chance node
+	state.move(action);
+	if(is_chance) {
+		state.place_fruit(-1);
+	}
+}
+
+MCTS::MCTS(const SnakeState& snake_state, int max_iterations, int max_rollout_depth, int gen_seed, double exploration_constant, RolloutPolicy rollout_policy)
+	:   nodes(make_unique<Arena<Node>>(DEFAULT_MAX_NODES)),
+		root(NO_NODE),
 		max_iterations(max_iterations),
 		max_rollout_depth(max_rollout_depth),
 		gen((gen_seed == -1) ? random_device{}() : gen_seed), //initialize random number generator
-		exploration_constant(exploration_constant) {}
+		exploration_constant(exploration_constant),
+		num_playouts(0),
+		num_playout_steps(0),
+		rollout_batch(1),
+		rollout_policy(rollout_policy),
+		trap_pruning(TRAPS_OFF),
+		is_pruning_rollout_traps(false),
+		rave_equivalence(0),
+		endgame_cells(DEFAULT_ENDGAME_CELLS),
+		num_pruned_nodes(0),
+		parallel_mode(PARALLEL_NONE),
+		state_caches(1),
+		is_caching_states(true),
+		transposition_replacement(TT_REPLACE_LEAST_VISITED),
+		is_stop_requested(false),
+		ponder_result{-1, 0} {
+	playout.set_policy(rollout_policy);
+	playout.set_distance_field(&fruit_distances);
+
+	//initialize root
+	reset_tree(snake_state);
+}
+
+MCTS::~MCTS() {
+	collect();
+}
+
+void MCTS::reset_tree(const SnakeState& snake_state) {
+	nodes->reset();
+	garbage_ranges.clear();
+	garbage_subtrees.clear();
+	root = nodes->allocate(1);
+	root_range = {root, 1, 1};
+	root_state = snake_state;
+	for(StateCache& cache : state_caches) {
+		cache.clear();
+	}
+	root_visits.store(0, memory_order_relaxed);
+	root_virtual_loss.store(0, memory_order_relaxed);
+	playout.resize(snake_state.width, snake_state.height);
+	reachability.resize(snake_state.width, snake_state.height);
+
+	//search spawns fruit from its own generator, the live game's fruit sequence is never touched
+	root_state.use_simulated_fruit(gen());
+	fruit_distances.build(root_state);
+	new (&get_node(root)) Node(NO_NODE, 0, -1, root_state.hash);
+}
+
+void MCTS::discard_path(uint32_t new_root) {
+	//the ranges above the new root only hold discarded nodes, the range of the new root becomes the root range
+	garbage_ranges.push_back(root_range);
+	for(uint32_t node = new_root; node != root; node = get_node(node).parent) {
+		ChildRange range = get_node(get_node(node).parent).get_children();
+		for(uint32_t i = 0; i < range.capacity; i++) {
+			if(range.first + i != node) {
+				garbage_subtrees.push_back(range.first + i);
+			}
+		}
+
+		if(node == new_root) {
+			root_range = range;
+		}
+		else {
+			garbage_ranges.push_back(range);
+		}
+	}
+}
+
+void MCTS::reclaim_memory() {
+	//discarded subtrees are walked here, on the search thread, update only queued their roots
+	for(const ChildRange& range : garbage_ranges) {
+		nodes->release(range.first, range.capacity);
+	}
+	garbage_ranges.clear();
+	while(!garbage_subtrees.empty()) {
+		uint32_t node = garbage_subtrees.back();
+		garbage_subtrees.pop_back();
+
+		ChildRange children = get_node(node).get_children();
+		nodes->release(children.first, children.capacity);
+		for(uint32_t i = 0; i < children.capacity; i++) {
+			garbage_subtrees.push_back(children.first + i);
+		}
+	}
+
+	//start with a quarter of the cap free, the least visited leaves go first
+	if(nodes->live() + nodes->capacity() / 4 > nodes->capacity()) {
+		prune_least_visited(nodes->capacity() - nodes->capacity() / 4);
+	}
+
+	//nothing left to prune, a search that cannot expand is worth less than the tree
+	if(nodes->live() + MAX_CHILD_SLOTS > nodes->capacity()) {
+		SnakeState snake_state = root_state;
+		reset_tree(snake_state);
+	}
+}
+
+void MCTS::prune_if_full() {
+	if(nodes->live() + MAX_CHILD_SLOTS > nodes->capacity()) {
+		prune_least_visited(nodes->capacity() - nodes->capacity() / 4);
+	}
+}
+
+void MCTS::prune_least_visited(uint32_t max_live) {
+	//a frontier node has only unexpanded children, collapsing it releases them and makes it a leaf again
+	//	it keeps its own statistics in its parent and is expanded again once selection reaches it
+	//	every pass collapses the least visited frontier nodes, their parents may form the next frontier
+	vector<pair<int, uint32_t>> frontier;
+	vector<uint32_t> stack;
+	while(nodes->live() > max_live) {
+		frontier.clear();
+		stack.assign(1, root);
+		while(!stack.empty()) {
+			uint32_t node = stack.back();
+			stack.pop_back();
+
+			Node& current_node = get_node(node);
+			ChildRange children = current_node.get_children();
+			bool is_frontier = node != root && children.capacity > 0;
+			int visits = 0;
+			for(uint32_t i = 0; i < children.capacity; i++) {
+				if(get_node(children.first + i).get_children().capacity > 0) {
+					is_frontier = false;
+					stack.push_back(children.first + i);
+				}
+				visits += current_node.child_visits[i].load(memory_order_relaxed);
+			}
+			if(is_frontier) {
+				frontier.push_back({visits, node});
+			}
+		}
+		if(frontier.empty()) {
+			break;
+		}
+
+		sort(frontier.begin(), frontier.end());
+		for(const auto& frontier_node : frontier) {
+			if(nodes->live() <= max_live) {
+				break;
+			}
+
+			Node& collapsed_node = get_node(frontier_node.second);
+			ChildRange children = collapsed_node.get_children();
+			nodes->release(children.first, children.capacity);
+			collapsed_node.children.store(UNEXPANDED, memory_order_relaxed);
+			collapsed_node.won_children.store(0, memory_order_relaxed);
+			collapsed_node.lost_children.store(0, memory_order_relaxed);
+			collapsed_node.is_exhaustive.store(false, memory_order_relaxed);
+			for(int i = 0; i < MAX_CHILD_SLOTS; i++) {
+				collapsed_node.child_visits[i].store(0, memory_order_relaxed);
+				collapsed_node.child_reward[i].store(0, memory_order_relaxed);
+				collapsed_node.child_virtual_loss[i].store(0, memory_order_relaxed);
+			}
+			num_pruned_nodes += children.capacity;
+		}
+	}
+}
+
+void MCTS::set_max_nodes(uint32_t max_nodes) {
+	collect();
+	SnakeState snake_state = root_state;
+	nodes = make_unique<Arena<Node>>(max(max_nodes, 2u));
+	reset_tree(snake_state);
+
+	for(auto& tree : root_trees) {
+		tree->set_max_nodes(max_nodes);
+	}
+}
 		
+void MCTS::set_transposition_table(size_t max_bytes, TTReplacement replacement) {
+	collect();
+	transpositions.reset((max_bytes > 0) ? new TranspositionTable(max_bytes, replacement) : nullptr);
+	transposition_replacement = replacement;
+
+	//root parallel trees stay independent so the search remains deterministic
+	for(auto& tree : root_trees) {
+		tree->set_transposition_table(max_bytes, replacement);
+	}
+}
+
+TreeStats MCTS::get_tree_stats() const {
+	TreeStats stats;
+	stats.live_nodes = nodes->live();
+	stats.high_water_nodes = nodes->high_water_mark();
+	stats.max_nodes = nodes->capacity();
+	stats.bytes = nodes->reserved_bytes();
+	stats.pruned_nodes = num_pruned_nodes;
+	for(const auto& tree : root_trees) {
+		TreeStats tree_stats = tree->get_tree_stats();
+		stats.live_nodes += tree_stats.live_nodes;
+		stats.high_water_nodes += tree_stats.high_water_nodes;
+		stats.max_nodes += tree_stats.max_nodes;
+		stats.bytes += tree_stats.bytes;
+		stats.pruned_nodes += tree_stats.pruned_nodes;
+	}
+
+	return stats;
+}
+
+SearchStats MCTS::get_search_stats() const {
+	SearchStats stats;
+	PlayoutStats playout_stats = get_playout_stats();
+	stats.rollouts = playout_stats.playouts;
+	stats.rollout_steps = playout_stats.steps;
+
+#ifdef MCTS_STATS
+	for(int tree_index = 0; tree_index <= int(root_trees.size()); tree_index++) {
+		const SearchCounters& counters = (tree_index == 0) ? search_counters : root_trees[tree_index - 1]->search_counters;
+		stats.selection_ns += counters.selection_ns.load(memory_order_relaxed);
+		stats.expansion_ns += counters.expansion_ns.load(memory_order_relaxed);
+		stats.rollout_ns += counters.rollout_ns.load(memory_order_relaxed);
+		stats.backpropagation_ns += counters.backpropagation_ns.load(memory_order_relaxed);
+		stats.selections += counters.selections.load(memory_order_relaxed);
+		stats.depth_sum += counters.depth_sum.load(memory_order_relaxed);
+		stats.max_depth = max(stats.max_depth, counters.max_depth.load(memory_order_relaxed));
+		stats.terminal_hits += counters.terminal_hits.load(memory_order_relaxed);
+		stats.nodes_created += counters.nodes_created.load(memory_order_relaxed);
+		stats.expansions += counters.expansions.load(memory_order_relaxed);
+		stats.expanded_children += counters.expanded_children.load(memory_order_relaxed);
+	}
+#endif
+
+	return stats;
+}
+
+#ifdef MCTS_STATS
+void MCTS::record_selection(uint32_t leaf, const SnakeState& leaf_state) {
+	uint32_t depth = 0;
+	for(uint32_t node = leaf; get_node(node).parent != NO_NODE; node = get_node(node).parent) {
+		depth++;
+	}
+
+	search_counters.selections.fetch_add(1, memory_order_relaxed);
+	search_counters.depth_sum.fetch_add(depth, memory_order_relaxed);
+	uint32_t max_depth = search_counters.max_depth.load(memory_order_relaxed);
+	while(depth > max_depth && !search_counters.max_depth.compare_exchange_weak(max_depth, depth, memory_order_relaxed)) {}
+
+	if(leaf_state.is_terminal() || leaf_state.is_max_length()) {
+		search_counters.terminal_hits.fetch_add(1, memory_order_relaxed);
+	}
+}
+#endif
+
+PlayoutStats MCTS::get_playout_stats() const {
+	PlayoutStats stats;
+	stats.playouts = num_playouts.load(memory_order_relaxed);
+	stats.steps = num_playout_steps.load(memory_order_relaxed);
+	for(const auto& tree : root_trees) {
+		PlayoutStats tree_stats = tree->get_playout_stats();
+		stats.playouts += tree_stats.playouts;
+		stats.steps += tree_stats.steps;
+	}
+
+	return stats;
+}
+
+TTStats MCTS::get_transposition_stats() const {
+	TTStats stats;
+	if(transpositions) {
+		stats = transpositions->get_stats();
+	}
+
+	for(const auto& tree : root_trees) {
+		TTStats tree_stats = tree->get_transposition_stats();
+		stats.lookups += tree_stats.lookups;
+		stats.hits += tree_stats.hits;
+		stats.replacements += tree_stats.replacements;
+		stats.bytes += tree_stats.bytes;
+	}
+
+	return stats;
+}
+
+void MCTS::set_trap_pruning(TrapPruning mode, bool in_rollouts) {
+	collect();
+	trap_pruning = mode;
+	is_pruning_rollout_traps = in_rollouts;
+	playout.set_trap_pruning(in_rollouts);
+	for(auto& tree : root_trees) {
+		tree->set_trap_pruning(mode, in_rollouts);
+	}
+}
+
+void MCTS::set_state_cache(bool is_enabled) {
+	collect();
+	is_caching_states = is_enabled;
+	for(StateCache& cache : state_caches) {
+		cache.clear();
+	}
+	for(auto& tree : root_trees) {
+		tree->set_state_cache(is_enabled);
+	}
+}
+
+void MCTS::set_rave(int equivalence) {
+	collect();
+	rave_equivalence = max(0, equivalence);
+	for(auto& tree : root_trees) {
+		tree->set_rave(rave_equivalence);
+	}
+}
+
+void MCTS::set_endgame_solver(int max_free_cells) {
+	collect();
+	endgame_cells = max(0, max_free_cells);
+}
+
+void MCTS::set_rollout_batch(int batch_size) {
+	collect();
+	rollout_batch = max(1, min(batch_size, MAX_PLAYOUT_BATCH));
+	for(auto& tree : root_trees) {
+		tree->set_rollout_batch(rollout_batch);
+	}
+}
+
+void MCTS::set_parallel(int num_threads, ParallelMode mode) {
+	collect();
+	num_threads = max(1, num_threads);
+	parallel_mode = (num_threads == 1) ? PARALLEL_NONE : mode;
+	pool = make_unique<ThreadPool>(num_threads);
+
+	//seed every extra tree and rollout slot from the main generator so runs are reproducible
+	root_trees.clear();
+	rollout_gens.clear();
+	state_caches.resize((parallel_mode == PARALLEL_LOCK_FREE) ? num_threads : 1);
+	if(parallel_mode == PARALLEL_ROOT) {
+		for(int i = 1; i < num_threads; i++) {
+			int tree_seed = gen() & 0x7fffffff;
+			root_trees.push_back(make_unique<MCTS>(root_state, max_iterations, max_rollout_depth, tree_seed, exploration_constant, rollout_policy));
+			root_trees.back()->set_max_nodes(nodes->capacity());
+			root_trees.back()->set_rollout_batch(rollout_batch);
+			root_trees.back()->set_trap_pruning(trap_pruning, is_pruning_rollout_traps);
+			root_trees.back()->set_state_cache(is_caching_states);
+			root_trees.back()->set_rave(rave_equivalence);
+			if(transpositions) {
+				root_trees.back()->set_transposition_table(transpositions->get_stats().bytes, transposition_replacement);
+			}
+		}
+	}
+	else if(parallel_mode != PARALLEL_NONE) {
+		for(int i = 0; i < num_threads; i++) {
+			rollout_gens.emplace_back(gen());
+		}
+	}
+}
+
 int MCTS::run_MCTS() {
 	//run MCTS for set number of iterations
-	for(int i = 0; i < max_iterations; i++) {
-		selection();
+	return run_MCTS(0, max_iterations).action;
+}
+
+SearchResult MCTS::run_MCTS(double time_budget, int iteration_budget) {
+	//at least one budget is needed, the iteration box is the fallback
+	if(time_budget <= 0 && iteration_budget <= 0) {
+		iteration_budget = max_iterations;
+	}
+	int iterations = (iteration_budget > 0) ? iteration_budget : numeric_limits<int>::max();
+	Clock::time_point deadline = Clock::time_point::max();
+	if(time_budget > 0) {
+		deadline = Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(time_budget));
 	}
 
-	//return best action after runtime completes
-	if(root->children.empty()) {
-		UtilityFunctions::print("MCTS REACHED END OF GAME");
-		return -1;
+	collect();
+	return run_search(iterations, deadline);
+}
+
+void MCTS::start_pondering(int iteration_budget) {
+	collect();
+
+	//the search thread owns the tree until collect, the caller only waits on it then
+	int iterations = (iteration_budget > 0) ? iteration_budget : numeric_limits<int>::max();
+	ponder_thread = thread([this, iterations] {
+		ponder_result = run_search(iterations, Clock::time_point::max());
+	});
+}
+
+SearchResult MCTS::collect() {
+	if(!is_pondering()) {
+		return {-1, 0};
 	}
 
+	request_stop(true);
+	ponder_thread.join();
+	request_stop(false);
+
+	return ponder_result;
+}
+
+void MCTS::request_stop(bool stop) {
+	is_stop_requested.store(stop, memory_order_relaxed);
+	for(auto& tree : root_trees) {
+		tree->request_stop(stop);
+	}
+}
+
+SearchResult MCTS::run_search(int iterations, Clock::time_point deadline) {
+	reclaim_memory();
+
+	//a decided root needs no search, the proven move is played at once
+	if(is_solved()) {
+		return {best_action(), 0};
+	}
+
+	//a nearly full board is searched exactly first, a proven win is played without iterations
+	if(endgame_cells > 0 && root_state.num_cells() - root_state.length <= endgame_cells) {
+		EndgameResult endgame_result = endgame.solve(root_state, ENDGAME_MAX_NODES);
+		endgame_stats.solves++;
+		endgame_stats.wins += endgame_result.proof == PROOF_WIN;
+		endgame_stats.losses += endgame_result.proof == PROOF_LOSS;
+		endgame_stats.nodes += endgame_result.nodes;
+		if(endgame_result.proof == PROOF_WIN) {
+			return {endgame_result.action, 0};
+		}
+	}
+
+	int completed = 0;
+	if(parallel_mode == PARALLEL_ROOT) {
+		//iterations are split between the trees, each thread searches its own tree
+		int tree_iterations = iterations / pool->size() + (iterations % pool->size() != 0);
+		vector<int> tree_completed(pool->size());
+		pool->run(pool->size(), [&](int tree) {
+			if(tree == 0) {
+				tree_completed[tree] = search(tree_iterations, deadline);
+			}
+			else {
+				root_trees[tree - 1]->reclaim_memory();
+				tree_completed[tree] = root_trees[tree - 1]->search(tree_iterations, deadline);
+			}
+		});
+		for(int tree_iterations_completed : tree_completed) {
+			completed += tree_iterations_completed;
+		}
+	}
+	else if(parallel_mode == PARALLEL_TREE) {
+		completed = search_tree_parallel(iterations, deadline);
+	}
+	else if(parallel_mode == PARALLEL_LOCK_FREE) {
+		completed = search_lock_free(iterations, deadline);
+	}
+	else {
+		completed = search(iterations, deadline);
+	}
+
+	//return best action after runtime completes
+	return {best_action(), completed};
+}
+
+int MCTS::best_action() {
 	//best action is chosen from the child with the most visits, the best action will be a child node of root
-	vector<shared_ptr<Node>> best_children = {root->children[0]};
-	for(int i = 1; i < root->children.size(); i++) {
-		if(best_children[0]->total_visits < root->children[i]->total_visits) { //select child node with most visits
-			best_children = {root->children[i]};
+	//in root parallel mode the visits of every tree are summed per action
+	//	a proven win is played before any open move, a proven loss only when every move loses, a proof of any tree holds for all of them
+	int action_visits[4] = {0, 0, 0, 0};
+	bool is_explored[4] = {false, false, false, false};
+	bool is_won[4] = {false, false, false, false};
+	bool is_lost[4] = {false, false, false, false};
+	for(int tree_index = 0; tree_index <= int(root_trees.size()); tree_index++) {
+		MCTS* tree = (tree_index == 0) ? this : root_trees[tree_index - 1].get();
+		Node& tree_root = tree->get_node(tree->root);
+		ChildRange children = tree_root.get_children();
+		for(uint32_t i = 0; i < children.count; i++) {
+			int action = tree->get_node(children.first + i).action;
+			action_visits[action] += tree_root.child_visits[i];
+			is_explored[action] = true;
+			is_won[action] |= (tree_root.won_children.load(memory_order_relaxed) >> i) & 1;
+			is_lost[action] |= (tree_root.lost_children.load(memory_order_relaxed) >> i) & 1;
+		}
+	}
+
+	vector<int> best_actions;
+	int best_rank = 0;
+	for(int action = 0; action < 4; action++) {
+		if(!is_explored[action]) {
+			continue;
 		}
-		else if(best_children[0]->total_visits == root->children[i]->total_visits) { //if multiple best childen then add as candidate
-			best_children.push_back(root->children[i]);
+
+		int rank = is_won[action] ? 2 : (is_lost[action] ? 0 : 1);
+		if(best_actions.empty() || best_rank < rank || (best_rank == rank && action_visits[best_actions[0]] < action_visits[action])) { //select action with most visits
+			best_actions = {action};
+			best_rank = rank;
+		}
+		else if(best_rank == rank && action_visits[best_actions[0]] == action_visits[action]) { //if multiple best actions then add as candidate
+			best_actions.push_back(action);
 		}
 	}
 
-	//randomly select a best child if multiple best children exist
-	uniform_int_distribution<int> dis(0, best_children.size() - 1);
-	shared_ptr<Node> best_child = best_children[dis(gen)];
+	//no children, game is over
+	if(best_actions.empty()) {
+		return -1;
+	}
 
-	return best_child->action;
+	//randomly select a best action if multiple best actions exist
+	uniform_int_distribution<int> dis(0, best_actions.size() - 1);
+	return best_actions[dis(gen)];
 }
 
-void MCTS::update(Array snake_matrix, int played_action) {
-	Vector2 prev_fruit_pos, curr_fruit_pos;
-	for(int y = 0; y < snake_matrix.size(); y++) {
-		Array row_prev = root->state[y];
-		Array row_curr = snake_matrix[y];
-		for(int x = 0; x < row_prev.size(); x++) {
-			int cell_value_prev = row_prev[x];
-			int cell_value_curr = row_curr[x];
-			
-			//find both fruit positions
-			if(cell_value_prev == -1) {
-				prev_fruit_pos = Vector2(x, y);
-			}
+int MCTS::search(int iterations, Clock::time_point deadline) {
+	if(rollout_batch > 1) {
+		return search_batched(iterations, deadline);
+	}
 
-			if(cell_value_curr == -1) {
-				curr_fruit_pos = Vector2(x, y);
+	bool has_deadline = deadline != Clock::time_point::max();
+	SnakeState leaf_state;
+	MoveSet played; //moves of the last simulation, only collected when RAVE is on
+	int completed = 0;
+	while(completed < iterations) {
+		//the first iteration always runs so the root is expanded and an action can be returned
+		if(completed > 0 && (is_stopped() || is_solved() || (has_deadline && completed % CLOCK_CHECK_INTERVAL == 0 && Clock::now() >= deadline))) {
+			break;
+		}
+
+		prune_if_full();
+		uint32_t leaf = expansion(selection(gen, leaf_state, state_caches[0]), leaf_state, gen, state_caches[0]);
+		if(leaf != NO_NODE) {
+			double reward = rollout(leaf, leaf_state, gen, (rave_equivalence > 0) ? &played : nullptr);
+			backpropagation(leaf, reward);
+			if(rave_equivalence > 0) {
+				backpropagate_amaf(leaf, leaf_state, played, reward);
 			}
 		}
+		completed++;
 	}
 
-	//soft update, matching fruit positions
-	if(prev_fruit_pos == curr_fruit_pos) {
-		for(auto& child : root->children) {
-			if(child->action == played_action) {
-				root = child;
-				root->parent.reset();
+	return completed;
+}
+
+int MCTS::search_batched(int iterations, Clock::time_point deadline) {
+	uint32_t leaves[MAX_PLAYOUT_BATCH];
+	vector<SnakeState> leaf_states(MAX_PLAYOUT_BATCH);
+	double rewards[MAX_PLAYOUT_BATCH];
+	vector<MoveSet> played((rave_equivalence > 0) ? MAX_PLAYOUT_BATCH : 0);
+
+	int completed = 0;
+	while(completed < iterations) {
+		if(completed > 0 && (is_stopped() || is_solved() || Clock::now() >= deadline)) {
+			break;
+		}
+		int batch_size = min(rollout_batch, iterations - completed);
+		prune_if_full();
 
-				return;
+		//virtual loss spreads the leaves of one batch over several paths
+		for(int i = 0; i < batch_size; i++) {
+			leaves[i] = descend(gen, leaf_states[i], state_caches[0]);
+		}
+		play_rollouts(leaves, leaf_states.data(), batch_size, rewards, gen, played.empty() ? nullptr : played.data());
+		for(int i = 0; i < batch_size; i++) {
+			if(leaves[i] != NO_NODE) {
+				backpropagation(leaves[i], rewards[i], true);
+				if(!played.empty()) {
+					backpropagate_amaf(leaves[i], leaf_states[i], played[i], rewards[i]);
+				}
 			}
 		}
+		completed += batch_size;
 	}
 
-	//hard update, non-matching fruit positions
-	else {
-		root = make_shared<Node>(nullptr, snake_matrix);
-	}
+	return completed;
 }
 
-void MCTS::selection() {
-	shared_ptr<Node> current_node = root;
-	
-	//select the best node balancing exploration and expansion
-	while(!current_node->children.empty()) {
-		double best_UCT = -numeric_limits<double>::infinity();
-		vector<shared_ptr<Node>> best_children;
+int MCTS::search_tree_parallel(int iterations, Clock::time_point deadline) {
+	int num_threads = pool->size();
+	vector<uint32_t> leaves(num_threads * rollout_batch);
+	vector<SnakeState> leaf_states(num_threads * rollout_batch);
+	vector<double> rewards(num_threads * rollout_batch);
+	vector<MoveSet> played((rave_equivalence > 0) ? num_threads * rollout_batch : 0);
+
+	int completed = 0;
+	while(completed < iterations) {
+		//a batch holds one rollout batch per thread, long enough to check the clock before every batch
+		if(completed > 0 && (is_stopped() || is_solved() || Clock::now() >= deadline)) {
+			break;
+		}
+		int batch_size = min(num_threads * rollout_batch, iterations - completed);
+		int num_tasks = (batch_size + rollout_batch - 1) / rollout_batch;
+		prune_if_full();
 
-		//calculate UCT (Upper Confidence bounds applied to Trees) for each node
-		for(const auto& child : current_node->children) {
-			double UCT;
+		//select leaves one after another, virtual loss steers later selections onto other paths
+		for(int i = 0; i < batch_size; i++) {
+			leaves[i] = descend(gen, leaf_states[i], state_caches[0]);
+		}
+
+		//rollouts run in parallel, each task has its own generator so results do not depend on scheduling
+		pool->run(num_tasks, [&](int task) {
+			int first = task * rollout_batch;
+			play_rollouts(&leaves[first], &leaf_states[first], min(rollout_batch, batch_size - first), &rewards[first], rollout_gens[task], played.empty() ? nullptr : &played[first]);
+		});
 
-			//prioritize children with no visits
-			if(child->total_visits == 0) {
-				UCT = numeric_limits<double>::infinity();
+		//backpropagate in batch order and release the virtual loss
+		for(int i = 0; i < batch_size; i++) {
+			if(leaves[i] != NO_NODE) {
+				backpropagation(leaves[i], rewards[i], true);
+				if(!played.empty()) {
+					backpropagate_amaf(leaves[i], leaf_states[i], played[i], rewards[i]);
+				}
 			}
-			else {
-				double exploitation = child->total_reward / child->total_visits;
-				double exploration = sqrt(log(current_node->total_visits) / child->total_visits);
-				UCT = exploitation + exploration_constant * exploration;
+		}
+		completed += batch_size;
+	}
+
+	return completed;
+}
+
+int MCTS::search_lock_free(int iterations, Clock::time_point deadline) {
+	//every thread runs whole iterations on the shared tree, statistics are atomic and children are
+	//published with compare-and-swap so no thread ever waits on another
+	bool has_deadline = deadline != Clock::time_point::max();
+	atomic<int> remaining_iterations(iterations);
+	atomic<int> completed(0);
+	atomic<bool> is_expired(false);
+	pool->run(pool->size(), [&](int worker) {
+		mt19937& rng = rollout_gens[worker];
+		StateCache& cache = state_caches[worker];
+		uint32_t leaves[MAX_PLAYOUT_BATCH];
+		vector<SnakeState> leaf_states(MAX_PLAYOUT_BATCH);
+		double rewards[MAX_PLAYOUT_BATCH];
+		vector<MoveSet> played((rave_equivalence > 0) ? MAX_PLAYOUT_BATCH : 0);
+		int worker_completed = 0;
+		int next_clock_check = CLOCK_CHECK_INTERVAL;
+		while(!is_expired.load(memory_order_relaxed)) {
+			//claim up to one rollout batch of iterations
+			int batch_size = 0;
+			while(batch_size < rollout_batch && remaining_iterations.fetch_sub(1, memory_order_relaxed) > 0) {
+				batch_size++;
 			}
+			if(batch_size == 0) {
+				break;
+			}
+
+			for(int i = 0; i < batch_size; i++) {
+				leaves[i] = descend(rng, leaf_states[i], cache);
+			}
+			play_rollouts(leaves, leaf_states.data(), batch_size, rewards, rng, played.empty() ? nullptr : played.data());
+			for(int i = 0; i < batch_size; i++) {
+				if(leaves[i] != NO_NODE) {
+					backpropagation(leaves[i], rewards[i], true);
+					if(!played.empty()) {
+						backpropagate_amaf(leaves[i], leaf_states[i], played[i], rewards[i]);
+					}
+				}
+			}
+			worker_completed += batch_size;
 
-			//new best UCT found, update candidate values
-			if(UCT > best_UCT) {
-				best_UCT = UCT;
-				best_children = {child};
+			//the first worker to see the deadline, a stop request or a decided root stops the others
+			bool is_clock_due = has_deadline && worker_completed >= next_clock_check;
+			if(is_clock_due) {
+				next_clock_check = worker_completed + CLOCK_CHECK_INTERVAL;
 			}
-			else if(UCT == best_UCT) {
-				best_children.push_back(child);
+			if(is_stopped() || is_solved() || (is_clock_due && Clock::now() >= deadline)) {
+				is_expired.store(true, memory_order_relaxed);
 			}
 		}
-		
-		//continue down the tree until a leaf node is reached
-		uniform_int_distribution<int> dis(0, best_children.size() - 1);
-		current_node = best_children[dis(gen)];
+		completed.fetch_add(worker_completed, memory_order_relaxed);
+	});
+
+	//ranges that lost a publish race join the garbage, the next search releases them
+	for(StateCache& cache : state_caches) {
+		garbage_ranges.insert(garbage_ranges.end(), cache.lost_ranges.begin(), cache.lost_ranges.end());
+		cache.lost_ranges.clear();
 	}
 
-	//node selected, move to expansion
-	expansion(current_node);
+	return completed.load(memory_order_relaxed);
 }
 
-void MCTS::expansion(shared_ptr<Node> node) {
-	//node is terminal, do not expand, immediately evaluate and backpropagate
-	if(is_terminal(node->state)) {
-		double reward = evaluate_state(node->state, node->state);
-		backpropagation(node, reward);
+uint32_t MCTS::descend(mt19937& rng, SnakeState& state, StateCache& cache) {
+	uint32_t node = selection(rng, state, cache, true);
+	uint32_t leaf = expansion(node, state, rng, cache);
 
-		return ;
+	//new nodes join the path, a chance node and its outcome when the move ate, nothing to roll out releases the path again
+	if(leaf == NO_NODE) {
+		release_virtual_loss(node);
+	}
+	for(uint32_t new_node = leaf; new_node != NO_NODE && new_node != node; new_node = get_node(new_node).parent) {
+		add_virtual_loss(new_node, 1);
 	}
 
-	//get possible actions and add each as a child node to current node
-	vector<int> possible_actions = get_possible_actions(node->state);
-	for(int action : possible_actions) {
-		Array next_state = move_snake(deep_duplicate(node->state), action); //simulate each possible action and get the next game state
-		shared_ptr<Node> child_node = make_shared<Node>(node, next_state, action); //create child node containing the next game state
-		node->children.push_back(child_node); //add child node to current node
+	return leaf;
+}
+
+Proof MCTS::proven_result(uint32_t node) const {
+	const Node& current_node = get_node(node);
+	ChildRange children = current_node.get_children();
+	if(children.capacity == 0) {
+		return PROOF_NONE;
 	}
 
-	//choose a random child to perform a rollout
-	if(!node->children.empty()) {
-		uniform_int_distribution<int> dis(0, node->children.size() - 1);
-		shared_ptr<Node> random_child = node->children[dis(gen)];
+	uint32_t all_children = (1u << children.capacity) - 1;
+	uint32_t won_children = current_node.won_children.load(memory_order_relaxed);
+	uint32_t lost_children = current_node.lost_children.load(memory_order_relaxed);
+	bool is_exhaustive = current_node.is_exhaustive.load(memory_order_relaxed);
+
+	//the fruit spawns anywhere, every possible spawn has to agree
+	if(current_node.is_chance) {
+		if(!is_exhaustive) {
+			return PROOF_NONE;
+		}
+		return (won_children == all_children) ? PROOF_WIN : ((lost_children == all_children) ? PROOF_LOSS : PROOF_NONE);
+	}
 
-		//random child selected, call rollout
-		rollout(random_child);
+	//the snake picks its move, one winning move is enough
+	if(won_children) {
+		return PROOF_WIN;
 	}
+	return (is_exhaustive && lost_children == all_children) ? PROOF_LOSS : PROOF_NONE;
 }
 
-void MCTS::rollout(shared_ptr<Node> node) {
-	//rollout perfoms random playouts from node to begin node evaluation
-	Array start_state = node->state;
-	Array end_state = start_state;
+Proof MCTS::proof_of(uint32_t node) const {
+	const Node& current_node = get_node(node);
+	if(current_node.parent == NO_NODE) {
+		return proven_result(node);
+	}
 
-	int rollout_iterations = 0;
-	while(!is_terminal(end_state) && rollout_iterations != max_rollout_depth && !is_max_length(end_state)) {
-		//perform random playout from possible actions
-		vector<int> possible_actions = get_possible_actions(start_state);
+	const Node& parent_node = get_node(current_node.parent);
+	if((parent_node.won_children.load(memory_order_relaxed) >> current_node.child_slot) & 1) {
+		return PROOF_WIN;
+	}
+	if((parent_node.lost_children.load(memory_order_relaxed) >> current_node.child_slot) & 1) {
+		return PROOF_LOSS;
+	}
+	return PROOF_NONE;
+}
 
-		//randomly select an action
-		uniform_int_distribution<int> dis(0, possible_actions.size() - 1);
-		int random_action = possible_actions[dis(gen)];
+bool MCTS::repeats_ancestor(uint32_t node) const {
+	//boards only repeat between two eats, the walk ends at the last fruit spawn
+	const Node& current_node = get_node(node);
+	for(uint32_t ancestor = current_node.parent; ancestor != NO_NODE; ancestor = get_node(ancestor).parent) {
+		const Node& ancestor_node = get_node(ancestor);
+		if(ancestor_node.hash == current_node.hash) {
+			return true;
+		}
+		if(ancestor == root || ancestor_node.action == -1 || ancestor_node.is_chance) {
+			break;
+		}
+	}
+	return false;
+}
+
+void MCTS::prove(uint32_t node, Proof proof) {
+	//bits are only ever set, a parent is proven once the bit of its last open child arrives
+	while(node != root) {
+		Node& current_node = get_node(node);
+		Node& parent_node = get_node(current_node.parent);
+		atomic<uint8_t>& proven_children = (proof == PROOF_WIN) ? parent_node.won_children : parent_node.lost_children;
+		proven_children.fetch_or(uint8_t(1 << current_node.child_slot), memory_order_relaxed);
 
-		//simulate selected action and update the current state
-		end_state = move_snake(deep_duplicate(start_state), random_action);
-		rollout_iterations++;
+		node = current_node.parent;
+		proof = proven_result(node);
+		if(proof == PROOF_NONE) {
+			break;
+		}
 	}
-	
-	//evaluate final node state from random playout and backpropogate the result
-	double result = evaluate_state(start_state, end_state);
-	backpropagation(node, result);
 }
 
-void MCTS::backpropagation(shared_ptr<Node> node, double simulation_reward) {
-	//backpropagate to every node up to the root node 
-	while(node) {
-		node->total_visits++;
-		node->total_reward += simulation_reward;
-		node = node->parent.lock();
-	}
-}
-
-bool MCTS::is_max_length(Array snake_matrix) {
-	for(int y = 0; y < snake_matrix.size(); y++) {
-		Array row = snake_matrix[y];
-		for(int x = 0; x < row.size(); x++) {
-			int cell_value = row[x];
-			
-			//snake is max length
-			if(cell_value == snake_matrix.size() * row.size()) {
-				return true;
+void MCTS::release_virtual_loss(uint32_t node) {
+	while(node != NO_NODE) {
+		add_virtual_loss(node, -1);
+		node = get_node(node).parent;
+	}
+}
+
+void MCTS::add_virtual_loss(uint32_t node, int amount) {
+	Node& current_node = get_node(node);
+	if(current_node.parent == NO_NODE) {
+		root_virtual_loss.fetch_add(amount, memory_order_relaxed);
+	}
+	else {
+		get_node(current_node.parent).child_virtual_loss[current_node.child_slot].fetch_add(amount, memory_order_relaxed);
+	}
+}
+
+void MCTS::update(const SnakeState& snake_state, int played_action) {
+	//the tree cannot be re-rooted under a running search
+	collect();
+
+	for(auto& tree : root_trees) {
+		tree->update(snake_state, played_action);
+	}
+
+	//soft update, the child of the played action holds the same state
+	//	when the move ate, the child is a chance node and the outcome that sampled the real spawn is kept
+	//	the rest of the old tree is queued as garbage and released when the next search starts
+	Node& root_node = get_node(root);
+	ChildRange children = root_node.get_children();
+	for(uint32_t i = 0; i < children.count; i++) {
+		if(get_node(children.first + i).action != played_action) {
+			continue;
+		}
+
+		uint32_t child = children.first + i;
+		int child_visits = root_node.child_visits[i];
+		if(get_node(child).is_chance) {
+			//unpublished outcomes are already built, the real spawn may be one of them
+			Node& chance_node = get_node(child);
+			ChildRange outcomes = chance_node.get_children();
+			child = NO_NODE;
+			for(uint32_t j = 0; j < outcomes.capacity; j++) {
+				if(get_node(outcomes.first + j).hash == snake_state.hash) {
+					child = outcomes.first + j;
+					child_visits = chance_node.child_visits[j];
+				}
 			}
 		}
+
+		if(child != NO_NODE && get_node(child).hash == snake_state.hash) {
+			//the new root state is replayed rather than copied, the tree's own fruit generator carries on
+			get_node(children.first + i).apply(root_state);
+			if(child != children.first + i) {
+				get_node(child).apply(root_state);
+			}
+			discard_path(child);
+			for(StateCache& cache : state_caches) {
+				cache.clear(); //cached depths are relative to the old root
+			}
+			root = child;
+			get_node(root).parent = NO_NODE;
+			root_visits.store(child_visits, memory_order_relaxed);
+			root_virtual_loss.store(0, memory_order_relaxed);
+			fruit_distances.build(root_state);
+
+			return;
+		}
 	}
 
-	return false;
+	//hard update, fruit spawned on a cell the search did not sample or unexplored action
+	reset_tree(snake_state);
 }
 
-bool MCTS::is_terminal(Array snake_matrix) {
-	int one_counter = 0;
-	for(int y = 0; y < snake_matrix.size(); y++) {
-		Array row = snake_matrix[y];
-		for(int x = 0; x < row.size(); x++) {
-			int cell_value = row[x];
-			
-			//count number of snake segments labeled 1
-			if(cell_value == 1) {
-				one_counter++;
-
-				//more than one segment labeled 1, state is terminal
-				if(one_counter > 1) {
-					return true;
+uint32_t MCTS::selection(mt19937& rng, SnakeState& state, StateCache& cache, bool apply_virtual_loss) {
+	MCTS_STATS_TIMER(selection_ns);
+	uint32_t current_node = root;
+	int parent_visits = root_visits.load(memory_order_relaxed) + root_virtual_loss.load(memory_order_relaxed);
+	if(apply_virtual_loss) {
+		root_virtual_loss.fetch_add(1, memory_order_relaxed);
+		parent_visits++;
+	}
+	
+	//select the best node balancing exploration and expansion
+	ChildRange children = get_node(current_node).get_children();
+	while(children.count > 0) {
+		//fruit spawns are not chosen, they are sampled
+		Node& parent_node = get_node(current_node);
+		if(parent_node.is_chance) {
+			int outcome_slot = select_outcome(current_node, children, parent_visits, rng);
+			current_node = children.first + outcome_slot;
+			parent_visits = parent_node.child_visits[outcome_slot].load(memory_order_relaxed) + parent_node.child_virtual_loss[outcome_slot].load(memory_order_relaxed);
+			if(apply_virtual_loss) {
+				parent_node.child_virtual_loss[outcome_slot].fetch_add(1, memory_order_relaxed);
+				parent_visits++;
+			}
+
+			//a decided spawn is a leaf, its proven reward is backpropagated
+			if(((parent_node.won_children.load(memory_order_relaxed) | parent_node.lost_children.load(memory_order_relaxed)) >> outcome_slot) & 1) {
+				break;
+			}
+			children = get_node(current_node).get_children();
+			continue;
+		}
+
+		//proven children are skipped, every child proven leaves the decided node as the leaf
+		uint32_t proven_children = parent_node.won_children.load(memory_order_relaxed) | parent_node.lost_children.load(memory_order_relaxed);
+		uint32_t open_children = ((1u << children.count) - 1) & ~proven_children;
+		if(open_children == 0) {
+			break;
+		}
+
+		//gather child statistics, pending parallel rollouts count as visits that returned no reward
+		alignas(32) double visits[MAX_CHILDREN] = {1, 1, 1, 1};
+		alignas(32) double rewards[MAX_CHILDREN] = {0, 0, 0, 0};
+		for(uint32_t i = 0; i < children.count; i++) {
+			visits[i] = parent_node.child_visits[i].load(memory_order_relaxed) + parent_node.child_virtual_loss[i].load(memory_order_relaxed);
+			rewards[i] = parent_node.child_reward[i].load(memory_order_relaxed);
+
+			//RAVE, the mean of every simulation that later played the child's move stands in for its own mean while the child has few visits
+			//	weight sqrt(k / (3n + k)) for n visits and equivalence k, rewards scaled back to a sum so UCT itself is unchanged
+			if(rave_equivalence > 0) {
+				int dir = get_node(children.first + i).action;
+				int amaf_visits = parent_node.amaf_visits(dir).load(memory_order_relaxed);
+				if(amaf_visits > 0 && visits[i] > 0) {
+					double beta = sqrt(rave_equivalence / (3 * visits[i] + rave_equivalence));
+					double amaf_mean = parent_node.amaf_reward(dir).load(memory_order_relaxed) / amaf_visits;
+					rewards[i] = (1 - beta) * rewards[i] + beta * visits[i] * amaf_mean;
 				}
 			}
+			if((proven_children >> i) & 1) {
+				visits[i] = 1;
+				rewards[i] = -numeric_limits<double>::infinity();
+			}
+		}
+
+		//calculate UCT for every child at once, ties are broken at random
+		uint32_t best_children = best_UCT_children(visits, rewards, children.count, cached_log(parent_visits), exploration_constant) & open_children;
+		if(best_children == 0) {
+			best_children = open_children;
+		}
+		uniform_int_distribution<int> dis(0, bit_count(best_children) - 1);
+		for(int skip = dis(rng); skip > 0; skip--) {
+			best_children &= best_children - 1;
+		}
+		int best_slot = lowest_bit(best_children);
+		
+		//continue down the tree until a leaf node is reached
+		current_node = children.first + best_slot;
+		parent_visits = int(visits[best_slot]);
+		if(apply_virtual_loss) {
+			parent_node.child_virtual_loss[best_slot].fetch_add(1, memory_order_relaxed);
+			parent_visits++;
 		}
+		children = get_node(current_node).get_children();
 	}
 
-	return false;
+	//node selected, rebuild its state and move to expansion
+	replay(current_node, state, cache);
+	MCTS_STATS_RECORD_SELECTION(current_node, state);
+	return current_node;
 }
 
-double MCTS::evaluate_state(Array start_state, Array end_state) {
-	if(is_max_length(end_state)) {
-		return 76.0;
+void MCTS::replay(uint32_t node, SnakeState& state, StateCache& cache) {
+	//walk up to the deepest cached ancestor, the root when caching is off
+	cache.path.clear();
+	const SnakeState* ancestor_state = &root_state;
+	int ancestor_depth = 0;
+	for(; node != root; node = get_node(node).parent) {
+		int slot = node % StateCache::SIZE;
+		if(is_caching_states && cache.nodes[slot] == node && cache.states[slot].hash == get_node(node).hash) {
+			ancestor_state = &cache.states[slot];
+			ancestor_depth = cache.depths[slot];
+			break;
+		}
+		cache.path.push_back(node);
 	}
-	else if(start_state == end_state ) {
-		return 0.0;
+
+	//replay the moves down to the node, checkpoints on the way are cached
+	state = *ancestor_state;
+	for(int i = int(cache.path.size()) - 1; i >= 0; i--) {
+		uint32_t path_node = cache.path[i];
+		get_node(path_node).apply(state);
+
+		int depth = ancestor_depth + int(cache.path.size()) - i;
+		int slot = path_node % StateCache::SIZE;
+		if(is_caching_states && depth % StateCache::INTERVAL == 0 && cache.nodes[slot] != path_node) {
+			cache.nodes[slot] = path_node;
+			cache.depths[slot] = depth;
+			cache.states[slot] = state;
+		}
 	}
+}
 
-	Vector2 head_pos, fruit_pos;
-
-	double snake_length_start = 0;
-	double snake_length_end = 0;
-	for(int y = 0; y < start_state.size(); y++) {
-		Array row_start = start_state[y];
-		Array row_end = end_state[y];
-		for(int x = 0; x < row_start.size(); x++) {
-			int cell_value_start = row_start[x];
-			int cell_value_end = row_end[x];
-			
-			//find snake length and head position
-			if(cell_value_start > snake_length_start) {
-				snake_length_start = cell_value_start;
-			}
+int MCTS::select_outcome(uint32_t node, ChildRange& children, int visits, mt19937& rng) {
+	//progressive widening, one more sampled spawn is published once the chance node has enough visits
+	//	a lost compare-and-swap means another thread widened it already
+	Node& chance_node = get_node(node);
+	uint32_t num_outcomes = min(children.capacity, uint32_t(ceil(CHANCE_WIDENING * sqrt(max(1, visits)))));
+	if(children.count < num_outcomes) {
+		uint64_t expected = pack_children(children.first, children.count, children.capacity);
+		chance_node.children.compare_exchange_strong(expected, pack_children(children.first, children.count + 1, children.capacity), memory_order_acq_rel);
+		children = chance_node.get_children();
+	}
 
-			if(cell_value_end > snake_length_end) {
-				snake_length_end = cell_value_end;
-				head_pos = Vector2(x, y);
-			}
+	//every outcome was drawn from the spawn distribution, so they are equally likely
+	uniform_int_distribution<int> dis(0, children.count - 1);
+	return dis(rng);
+}
 
-			//find fruit position
-			if(cell_value_end == -1) {
-				fruit_pos = Vector2(x, y);
+uint32_t MCTS::expansion(uint32_t node, SnakeState& state, mt19937& rng, StateCache& cache) {
+	MCTS_STATS_TIMER(expansion_ns);
+	//node is terminal or decided, do not expand, its proven reward is backpropagated
+	Node& parent_node = get_node(node);
+	if(proof_of(node) != PROOF_NONE) {
+		return node;
+	}
+	if(state.is_terminal() || state.is_max_length()) {
+		prove(node, state.is_max_length() ? PROOF_WIN : PROOF_LOSS);
+		return node;
+	}
+	//an expanded node is only selected once all its children are proven, it is rolled out again rather than expanded twice
+	if(parent_node.get_children().capacity > 0) {
+		return node;
+	}
+	if(parent_node.is_chance) {
+		return expand_chance(node, state, rng, cache);
+	}
+
+	//a snake circling back to an earlier board only repeats the tree above, the repeat stays a leaf
+	if(repeats_ancestor(node)) {
+		return node;
+	}
+
+	//children take one contiguous range of the arena, a full arena leaves the node as a leaf
+	int possible_actions = state.legal_moves();
+	int trapped_actions = 0;
+	if(trap_pruning != TRAPS_OFF) {
+		trapped_actions = reachability.trapped_moves(state, possible_actions);
+		if(trap_pruning == TRAPS_PRUNE && trapped_actions != possible_actions) {
+			possible_actions &= ~trapped_actions;
+		}
+	}
+	uint32_t num_children = bit_count(possible_actions);
+	uint32_t first_child = NO_NODE;
+	if(num_children > 0) {
+		first_child = nodes->allocate(num_children);
+		if(first_child == NO_NODE) {
+			return node;
+		}
+	}
+	MCTS_STATS_ADD(nodes_created, num_children);
+
+	//get possible actions and add each as a child node to current node
+	uint8_t won_children = 0;
+	uint8_t lost_children = 0;
+	for(uint32_t i = 0; i < num_children; i++) {
+		int action = lowest_bit(possible_actions);
+		possible_actions &= possible_actions - 1;
+
+		SnakeState child_state = state;
+		MoveResult result = child_state.move(action); //simulate each possible action and get the next game state
+
+		//the spawn that follows an eat becomes a chance node, its outcomes are sampled when it is expanded
+		Node* child_node = new (&get_node(first_child + i)) Node(node, i, action);
+		if(result == MOVE_ATE && !child_state.is_max_length()) {
+			child_state.place_fruit(-1);
+			child_node->is_chance = true;
+		}
+		child_node->hash = child_state.hash;
+		won_children |= uint8_t(child_state.is_max_length()) << i;
+		lost_children |= uint8_t(child_state.is_terminal()) << i;
+	}
+
+	//publish the children, if another thread expanded this node first use its children instead
+	//the unused range is queued and released once the search is over, the arena cannot take it back while threads allocate
+	uint64_t expected = UNEXPANDED;
+	bool is_published = parent_node.children.compare_exchange_strong(expected, pack_children(first_child, num_children, num_children), memory_order_acq_rel);
+	ChildRange children = parent_node.get_children();
+	if(!is_published && num_children > 0) {
+		cache.lost_ranges.push_back({first_child, num_children, num_children});
+	}
+	if(is_published) {
+		MCTS_STATS_ADD(expansions, 1);
+		MCTS_STATS_ADD(expanded_children, num_children);
+	}
+
+	//moves that end the game are proven right away, a node whose moves all die is lost before any rollout
+	//	moves left out by legal_moves die at once and pruned moves lead into a pocket too small to live in, neither can save a losing node
+	if(is_published) {
+		parent_node.is_exhaustive.store(true, memory_order_relaxed);
+		parent_node.won_children.fetch_or(won_children, memory_order_relaxed);
+		parent_node.lost_children.fetch_or(lost_children, memory_order_relaxed);
+		Proof proof = proven_result(node);
+		if(proof != PROOF_NONE) {
+			prove(node, proof);
+		}
+	}
+
+	//children reached before through another move order start with the statistics of their state
+	//added rather than stored, a parallel search may already be backpropagating through them
+	if(is_published && transpositions) {
+		warm_start(node, children.count);
+	}
+
+	//children walking into a pocket start as if they had already lost a few rollouts
+	if(is_published && trap_pruning == TRAPS_PENALIZE && trapped_actions) {
+		for(uint32_t i = 0; i < children.count; i++) {
+			if(trapped_actions >> get_node(children.first + i).action & 1) {
+				parent_node.child_visits[i].fetch_add(TRAP_PENALTY_VISITS, memory_order_relaxed);
 			}
 		}
 	}
 
-	//calculate reward
-	double length_reward;
-	double fruit_reward;
+	//choose a random child to perform a rollout
+	if(children.count == 0) {
+		return NO_NODE;
+	}
 
-	Array row = start_state[0];
-	double max_dist = start_state.size() * row.size();
+	//a chance node is rolled out from one of its spawns, a playout without a fruit never eats
+	uniform_int_distribution<int> dis(0, children.count - 1);
+	uint32_t leaf = children.first + dis(rng);
+	get_node(leaf).apply(state);
+	return get_node(leaf).is_chance ? expand_chance(leaf, state, rng, cache) : leaf;
+}
 
-	double reward;
-	if(snake_length_end > snake_length_start) {
-		reward = snake_length_end / max_dist;
+void MCTS::warm_start(uint32_t node, uint32_t num_children) {
+	//the children together never start with more visits than the node has, or UCT's log term would undercount them
+	//	a state reached through several paths can hold far more visits than this path, its visits are scaled down and its mean kept
+	Node& parent_node = get_node(node);
+	ChildRange children = parent_node.get_children();
+	int table_visits[MAX_CHILD_SLOTS] = {};
+	double table_rewards[MAX_CHILD_SLOTS] = {};
+	int total_visits = 0;
+	for(uint32_t i = 0; i < num_children; i++) {
+		if(transpositions->probe(get_node(children.first + i).hash, table_visits[i], table_rewards[i])) {
+			total_visits += table_visits[i];
+		}
 	}
-	else {
-		double dist = abs(head_pos.x - fruit_pos.x) + abs(head_pos.y - fruit_pos.y); //manhattan distance
-		reward = (max_dist * snake_length_start + max_dist - dist) / (max_dist * start_state.size() * row.size());
+	if(total_visits == 0) {
+		return;
 	}
 
-	//UtilityFunctions::print("REWARD: " + String::num_real(reward));
-	return reward;
+	int node_visits = (parent_node.parent == NO_NODE) ? root_visits.load(memory_order_relaxed) : get_node(parent_node.parent).child_visits[parent_node.child_slot].load(memory_order_relaxed);
+	double scale = min(1.0, double(node_visits) / total_visits);
+	for(uint32_t i = 0; i < num_children; i++) {
+		int visits = int(table_visits[i] * scale);
+		if(visits > 0) {
+			parent_node.child_visits[i].fetch_add(visits, memory_order_relaxed);
+			atomic_add(parent_node.child_reward[i], table_rewards[i] * visits / table_visits[i]);
+		}
+	}
 }
 
-vector<int> MCTS::get_possible_actions(Array snake_matrix) {
-	//find current head position and snake length
-	Vector2 head_pos, prev_head_pos; 
-	int snake_length = 0;
-	int prev_head_val = 0;
-
-	Array row;
-	int cell_value;
-	for(int y = 0; y < snake_matrix.size(); y++) {
-		row = snake_matrix[y];
-		for(int x = 0; x < row.size(); x++) {
-			cell_value = row[x];
-			
-			//largest cell will contain head position and current length
-			if(cell_value > snake_length) {
-				prev_head_pos = head_pos;
-				prev_head_val = snake_length;
-
-				head_pos = Vector2(x, y);
-				snake_length = cell_value;
+uint32_t MCTS::expand_chance(uint32_t node, SnakeState& state, mt19937& rng, StateCache& cache) {
+	//every empty cell is an outcome on a nearly full board, otherwise distinct cells are sampled
+	Node& chance_node = get_node(node);
+	const SnakeState& chance_state = state;
+	int empty_cells = chance_state.num_cells() - chance_state.length;
+	uint32_t num_outcomes = min(empty_cells, MAX_CHANCE_OUTCOMES);
+	uint32_t first_outcome = nodes->allocate(num_outcomes);
+	if(first_outcome == NO_NODE) {
+		return node;
+	}
+	MCTS_STATS_ADD(nodes_created, num_outcomes);
+
+	//widening publishes the outcomes in order, so they are drawn in a random order
+	int cells[MAX_CHANCE_OUTCOMES];
+	for(uint32_t i = 0; i < num_outcomes; i++) {
+		int index = uniform_int_distribution<int>(0, empty_cells - 1)(rng);
+		cells[i] = chance_state.nth_empty_cell(index);
+		for(uint32_t j = 0; j < i; j++) {
+			if(cells[j] == cells[i]) {
+				i--; //drawn before, draw again
+				break;
 			}
-			else if(cell_value > prev_head_val) {
-				prev_head_pos = Vector2(x, y);
-				prev_head_val = cell_value;
+		}
+	}
+	for(uint32_t i = 0; i < num_outcomes; i++) {
+		Node* outcome_node = new (&get_node(first_outcome + i)) Node(node, i, -1, chance_state.fruit_hash(cells[i]));
+		outcome_node->fruit_cell = cells[i];
+	}
+
+	//every outcome is built before the range is published, widening only raises the count
+	uint64_t expected = UNEXPANDED;
+	bool is_published = chance_node.children.compare_exchange_strong(expected, pack_children(first_outcome, 1, num_outcomes), memory_order_acq_rel);
+	ChildRange children = chance_node.get_children();
+	if(!is_published) {
+		cache.lost_ranges.push_back({first_outcome, num_outcomes, num_outcomes});
+	}
+	if(is_published) {
+		chance_node.is_exhaustive.store(int(num_outcomes) == empty_cells, memory_order_relaxed);
+	}
+	if(is_published && transpositions) {
+		warm_start(node, children.capacity);
+	}
+
+	uniform_int_distribution<int> outcome_dis(0, children.count - 1);
+	uint32_t outcome = children.first + outcome_dis(rng);
+	get_node(outcome).apply(state);
+	return outcome;
+}
+
+double MCTS::rollout(uint32_t leaf, const SnakeState& leaf_state, mt19937& rng, MoveSet* played) {
+	MCTS_STATS_TIMER(rollout_ns);
+	if(played != nullptr) {
+		played->clear();
+	}
+	Proof proof = proof_of(leaf);
+	if(proof != PROOF_NONE) {
+		return (proof == PROOF_WIN) ? WIN_REWARD : LOSS_REWARD;
+	}
+
+	//rollout perfoms a random playout from the leaf to begin node evaluation
+	//the playout advances one copy of the leaf state in place for the full depth
+	const SnakeState& start_state = leaf_state;
+	SnakeState end_state = start_state;
+	int steps = playout.play(end_state, max_rollout_depth, rng, played);
+
+	num_playouts.fetch_add(1, memory_order_relaxed);
+	num_playout_steps.fetch_add(steps, memory_order_relaxed);
+	
+	//evaluate final node state from random playout
+	return evaluate_state(start_state, end_state);
+}
+
+void MCTS::backpropagation(uint32_t node, double simulation_reward, bool remove_virtual_loss) {
+	MCTS_STATS_TIMER(backpropagation_ns);
+	//backpropagate to every node up to the root node 
+	//statistics of a node are stored in its parent, the root keeps its own
+	while(node != NO_NODE) {
+		Node& current_node = get_node(node);
+		if(transpositions) {
+			transpositions->store(current_node.hash, simulation_reward);
+		}
+
+		if(current_node.parent == NO_NODE) {
+			root_visits.fetch_add(1, memory_order_relaxed);
+			if(remove_virtual_loss) {
+				root_virtual_loss.fetch_sub(1, memory_order_relaxed);
 			}
+			break;
+		}
+
+		Node& parent_node = get_node(current_node.parent);
+		parent_node.child_visits[current_node.child_slot].fetch_add(1, memory_order_relaxed);
+		atomic_add(parent_node.child_reward[current_node.child_slot], simulation_reward);
+		if(remove_virtual_loss) {
+			parent_node.child_virtual_loss[current_node.child_slot].fetch_sub(1, memory_order_relaxed);
 		}
+		node = current_node.parent;
 	}
+}
+
+void MCTS::backpropagate_amaf(uint32_t leaf, const SnakeState& leaf_state, MoveSet& played, double simulation_reward) {
+	//head cells are recovered walking up, each move into a node steps back from its head, a move that killed left the head where it was
+	static const int step_x[4] = {0, 1, 0, -1};
+	static const int step_y[4] = {-1, 0, 1, 0};
+	int width = leaf_state.width;
+	int head_cell = leaf_state.head();
+	bool is_head_moved = !leaf_state.is_dead;
+	for(uint32_t node = leaf; get_node(node).parent != NO_NODE; node = get_node(node).parent) {
+		const Node& current_node = get_node(node);
+		if(current_node.action == -1) {
+			continue; //a fruit spawn, the head stays
+		}
 
-	if(snake_length < 2) {
-		return {};
+		//the move into the node joins the set first, the parent credits its own choice too
+		//	the snake is the only player, so every later move from the parent's cell counts however often the cell was left before
+		int action = current_node.action;
+		if(is_head_moved) {
+			head_cell -= step_y[action] * width + step_x[action];
+		}
+		is_head_moved = true;
+		played.add(head_cell, action);
+
+		Node& parent_node = get_node(current_node.parent);
+		for(int moves = played.moves_from(head_cell); moves; moves &= moves - 1) {
+			int dir = lowest_bit(moves);
+			parent_node.amaf_visits(dir).fetch_add(1, memory_order_relaxed);
+			atomic_add(parent_node.amaf_reward(dir), simulation_reward);
+		}
 	}
+}
 
-	//find direction snake moved previously
-	int prev_move_dir;
-	Vector2 movement_delta = head_pos - prev_head_pos;
-	if     (movement_delta == Vector2(0, -1)) prev_move_dir = 0; //prev move north
-	else if(movement_delta == Vector2(1, 0))  prev_move_dir = 1; //prev move east
-	else if(movement_delta == Vector2(0, 1))  prev_move_dir = 2; //prev move south
-	else if(movement_delta == Vector2(-1, 0)) prev_move_dir = 3; //prev move west
+void MCTS::play_rollouts(const uint32_t* leaves, const SnakeState* leaf_states, int count, double* rewards, mt19937& rng, MoveSet* played) {
+	//a single leaf takes the plain rollout
+	if(count == 1) {
+		if(leaves[0] != NO_NODE) {
+			rewards[0] = rollout(leaves[0], leaf_states[0], rng, played);
+		}
+		return;
+	}
+	if(played != nullptr) {
+		for(int i = 0; i < count; i++) {
+			played[i].clear();
+		}
+	}
 
-	//return all moves excluding 180 degree turn
-	vector<int> action_vec;
-	for(int i = 0; i < 4; i++) {
-		if(i == (prev_move_dir + 2) % 4) {
+	//copy every leaf state into one contiguous batch, played together in lockstep
+	MCTS_STATS_TIMER(rollout_ns);
+	SnakeState end_states[MAX_PLAYOUT_BATCH];
+	int batch_leaves[MAX_PLAYOUT_BATCH];
+	int num_states = 0;
+	for(int i = 0; i < count; i++) {
+		if(leaves[i] == NO_NODE) {
 			continue;
 		}
-		else {
-			action_vec.push_back(i);
+
+		//decided leaves take their proven reward
+		Proof proof = proof_of(leaves[i]);
+		if(proof != PROOF_NONE) {
+			rewards[i] = (proof == PROOF_WIN) ? WIN_REWARD : LOSS_REWARD;
+			continue;
 		}
+		end_states[num_states] = leaf_states[i];
+		batch_leaves[num_states++] = i;
 	}
 
-	//allow snake to win
-	if(snake_length == snake_matrix.size() * row.size() - 1) {
-		return action_vec;
+	//moves are collected in batch order and handed back to the leaf they were played for
+	MoveSet batch_played[MAX_PLAYOUT_BATCH];
+	if(played != nullptr) {
+		for(int i = 0; i < num_states; i++) {
+			batch_played[i].clear();
+		}
 	}
+	uint64_t steps = playout.play_batch(end_states, num_states, max_rollout_depth, rng, (played != nullptr) ? batch_played : nullptr);
+	num_playouts.fetch_add(num_states, memory_order_relaxed);
+	num_playout_steps.fetch_add(steps, memory_order_relaxed);
 
-	//only return safe moves, do not allow snake to move into death unless only move available
-	vector<int> safe_moves;
-	for(int action : action_vec) {
-		Array potential_safe_move = move_snake(deep_duplicate(snake_matrix), action);
-
-		//check if move is safe
-		if(!is_terminal(potential_safe_move)) {
-			safe_moves.push_back(action);
+	for(int i = 0; i < num_states; i++) {
+		int leaf_index = batch_leaves[i];
+		rewards[leaf_index] = evaluate_state(leaf_states[leaf_index], end_states[i]);
+		if(played != nullptr) {
+			played[leaf_index] = batch_played[i];
 		}
 	}
+}
 
-	if(!safe_moves.empty()) {
-		return safe_moves;
+double MCTS::evaluate_state(const SnakeState& start_state, const SnakeState& end_state) {
+	if(end_state.is_max_length()) {
+		return WIN_REWARD;
+	}
+	else if(start_state == end_state) {
+		return 0.0;
+	}
+
+	//find snake length and head position, a dead snake has every segment labeled 1
+	//and its head is read as the first segment in row major order
+	double snake_length_start = start_state.is_dead ? 1 : start_state.length;
+	double snake_length_end = end_state.is_dead ? 1 : end_state.length;
+
+	int head_cell = end_state.is_dead ? end_state.first_body_cell() : end_state.head();
+
+	//find fruit position, defaults to the origin when the board has no fruit
+	int fruit_cell = (end_state.fruit == -1) ? 0 : end_state.fruit;
+
+	//calculate reward
+	double max_dist = start_state.num_cells();
+
+	double reward;
+	if(snake_length_end > snake_length_start) {
+		reward = snake_length_end / max_dist;
 	}
 	else {
-		return action_vec;
+		//moves around the body while the root fruit is still on the board, manhattan distance once it was eaten
+		double dist = fruit_distances.distance(head_cell, fruit_cell);
+		reward = (max_dist * snake_length_start + max_dist - dist) / (max_dist * start_state.num_cells());
 	}
+
+	return reward;
 }
@@ -1,71 +1,322 @@
 #pragma once
 
-// Godot SDK
-#include <Godot/godot.hpp>
+// Standard library, MCTS has no Godot dependency so it also builds headless
 #include <iostream>
 #include <vector>
 #include <cmath>
 #include <functional>
 #include <memory>
 #include <random>
-#include <Godot/variant/array.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
-// Jenova SDK
-#include <JenovaSDK.h>
-#include <headers/snake_functions.hpp>
-#include <headers/MCTS.hpp>
+#include <headers/snake_state.hpp>
+#include <headers/thread_pool.hpp>
+#include <headers/arena.hpp>
+#include <headers/transposition_table.hpp>
+#include <headers/playout.hpp>
+#include <headers/reachability.hpp>
+#include <headers/distance_field.hpp>
+#include <headers/endgame_solver.hpp>
 
 // Namespaces
-using namespace godot;
-using namespace jenova::sdk;
 using namespace std;
 
+//parallel search modes
+enum ParallelMode {
+	PARALLEL_NONE, //single threaded search
+	PARALLEL_ROOT, //independent tree per thread, root child visits are summed to pick the action
+	PARALLEL_TREE, //shared tree, leaves are selected with virtual loss and rolled out in parallel
+	PARALLEL_LOCK_FREE //shared tree, threads descend, expand and backpropagate freely, not deterministic
+};
+
+//handling of moves into pockets smaller than the snake during expansion
+enum TrapPruning {
+	TRAPS_OFF,     //every legal move becomes a child
+	TRAPS_PRUNE,   //trapped moves get no child unless every move is trapped
+	TRAPS_PENALIZE //trapped moves start with visits that returned no reward
+};
+
+//tree memory of a search
+struct TreeStats {
+	uint32_t live_nodes = 0; //nodes allocated and not released
+	uint32_t high_water_nodes = 0; //most nodes the arena ever spanned
+	uint32_t max_nodes = 0;
+	size_t bytes = 0; //memory reserved by the arena
+	uint64_t pruned_nodes = 0; //leaves released to stay under the cap
+};
+
+//where a search spends its time, summed over every search since construction
+//	phase timers and tree counters are only kept when the core is built with MCTS_STATS, they read 0 otherwise
+struct SearchStats {
+	//time spent in each phase, in nanoseconds
+	uint64_t selection_ns = 0;
+	uint64_t expansion_ns = 0;
+	uint64_t rollout_ns = 0;
+	uint64_t backpropagation_ns = 0;
+
+	uint64_t selections = 0;
+	uint64_t depth_sum = 0; //depth of every selected leaf, summed
+	uint32_t max_depth = 0; //deepest selected leaf
+	uint64_t terminal_hits = 0; //selected leaves holding a finished game
+	uint64_t nodes_created = 0; //children and fruit spawns allocated by expansion
+	uint64_t expansions = 0; //move nodes given children
+	uint64_t expanded_children = 0; //children of those nodes
+
+	//always counted, same as PlayoutStats
+	uint64_t rollouts = 0;
+	uint64_t rollout_steps = 0;
+
+	double mean_depth() const { return selections ? double(depth_sum) / selections : 0; }
+	double branching_factor() const { return expansions ? double(expanded_children) / expansions : 0; }
+	double mean_rollout_length() const { return rollouts ? double(rollout_steps) / rollouts : 0; }
+};
+
+//outcome of a budgeted search
+struct SearchResult {
+	int action; //best action found, -1 if the game is over
+	int iterations; //iterations completed before the budget ran out
+};
+
 class MCTS {
+	friend class MCTSBenchmark; //micro benchmarks of the private search steps, see headless/snake_suite.cpp
+
 private:
-	//MCTS node structure
+	using Clock = chrono::steady_clock;
+	static constexpr int CLOCK_CHECK_INTERVAL = 16; //iterations between deadline checks, reading the clock costs more than a short rollout
+
+	static constexpr uint32_t NO_NODE = 0xffffffff; //same value as Arena::NONE
+	static constexpr uint64_t UNEXPANDED = 0; //children value of a node that was never expanded
+
+	//contiguous children of a node
+	struct ChildRange {
+		uint32_t first;
+		uint32_t count; //children selection may visit
+		uint32_t capacity; //children allocated, chance nodes publish them one at a time
+	};
+
+	static constexpr int MAX_CHILDREN = 4; //one child per move direction
+	static constexpr int MAX_CHANCE_OUTCOMES = 8; //fruit spawns sampled under a chance node
+	static constexpr int MAX_CHILD_SLOTS = (MAX_CHILDREN > MAX_CHANCE_OUTCOMES) ? MAX_CHILDREN : MAX_CHANCE_OUTCOMES;
+	static_assert(MAX_CHILD_SLOTS >= 2 * MAX_CHILDREN, "move nodes keep their all-moves-as-first statistics in the spare child slots");
+	static constexpr double CHANCE_WIDENING = 0.1; //a chance node with n visits has up to CHANCE_WIDENING * sqrt(n) outcomes
+
+	//MCTS node structure, nodes live in an arena and link to each other by index
+	//	a node holds no board, the state of a node is rebuilt by replaying the moves from the root state during descent
 	struct Node {
 		//tree structure
-		weak_ptr<Node> parent;
-		vector<shared_ptr<Node>> children;
+		uint32_t parent; //NO_NODE for the root
+		int child_slot; //position of this node in the parent's child range
+		atomic<uint64_t> children; //first child index, child count and capacity, published with compare-and-swap
+		bool is_chance; //the move into this node ate the fruit, its children are the fruit spawns
+
+		//solver, bit i is set once child i is proven
+		//	a move node is won by any won child and lost when every child is lost, a chance node only when every spawn agrees
+		atomic<uint8_t> won_children;
+		atomic<uint8_t> lost_children;
+		atomic<bool> is_exhaustive; //the children cover every move that does not lose or every empty cell, set once they are published
+
+		//statistics of the children as parallel arrays, selection reads them together from one cache line
+		//atomic so threads can share the tree without a mutex
+		atomic<int> child_visits[MAX_CHILD_SLOTS];
+		atomic<double> child_reward[MAX_CHILD_SLOTS];
+		atomic<int> child_virtual_loss[MAX_CHILD_SLOTS]; //pending parallel rollouts, counted as visits without reward
+
+		//all-moves-as-first statistics of a move node by direction from its head cell, only kept when RAVE is on
+		//	a simulation through the node counts for every direction it later moved from that cell, in the tree or in the playout
+		//	they take the slots past MAX_CHILDREN, which only the fruit outcomes of a chance node use
+		atomic<int>& amaf_visits(int dir) { return child_visits[MAX_CHILDREN + dir]; }
+		atomic<double>& amaf_reward(int dir) { return child_reward[MAX_CHILDREN + dir]; }
 
-		//node values
-		int total_visits;
-		double total_reward;
-		Array state;
-		int action;
+		int action; //move into this node, -1 for the fruit outcomes of a chance node
+		int fruit_cell; //spawn of a fruit outcome, -1 otherwise
+		uint64_t hash; //Zobrist hash of the state, matches the played state on update and keys the transposition table
 
 		//node constructor
-		Node(shared_ptr<Node> parent = nullptr, Array node_state = Array(), int action = -1) 
-		:   parent(parent), total_visits(0), total_reward(0), state(node_state), action(action) {}
+		Node(uint32_t parent = NO_NODE, int child_slot = 0, int action = -1, uint64_t hash = 0);
+
+		ChildRange get_children() const; //single load, only the count of a chance node grows once published
+		void apply(SnakeState& state) const; //turns the state of the parent into the state of this node
+	};
+
+	//states of checkpoint nodes, a descent only replays the moves below its deepest cached ancestor
+	//	direct mapped by node index, every searching thread has its own cache so entries are never shared
+	struct StateCache {
+		static constexpr int SIZE = 64;
+		static constexpr int INTERVAL = 4; //nodes at every fourth depth below the root are cached
+
+		uint32_t nodes[SIZE];
+		int depths[SIZE];
+		vector<SnakeState> states;
+		vector<uint32_t> path; //nodes replayed by the last descent, kept to reuse its memory
+		vector<ChildRange> lost_ranges; //children built by this thread for a node another thread published first, released after the search
+
+		StateCache() : states(SIZE) { clear(); }
+		void clear() { fill(nodes, nodes + SIZE, NO_NODE); }
 	};
 
+	static uint64_t pack_children(uint32_t first_child, uint32_t child_count, uint32_t capacity) { return (uint64_t(capacity) << 48) | (uint64_t(child_count) << 32) | first_child; }
+
 	//MCTS assorted values
-	shared_ptr<Node> root;
+	unique_ptr<Arena<Node>> nodes; //every node of the tree, capped at max_nodes
+	uint32_t root;
+	SnakeState root_state; //the only stored board, every other state is replayed from it
+	ChildRange root_range; //arena range holding the root, released once the root is discarded
+	atomic<int> root_visits; //the root has no parent holding its statistics
+	atomic<int> root_virtual_loss;
 	int max_iterations; //number of nodes to be explored before selecting best node
 	int max_rollout_depth; //number of moves to play before terminating rollout
 	double exploration_constant; //constant used in the selection function, default to sqrt(2) -> optimal for rewards in [0, 1]
 	mt19937 gen; //random number generator
 
+	//rollouts
+	PlayoutEngine playout; //sized to the board of the root state
+	atomic<uint64_t> num_playouts;
+	atomic<uint64_t> num_playout_steps;
+	static constexpr int TRAP_PENALTY_VISITS = 4;
+
+	int rollout_batch; //leaves selected with virtual loss and rolled out together, 1 rolls out every leaf on its own
+	RolloutPolicy rollout_policy;
+	TrapPruning trap_pruning;
+	bool is_pruning_rollout_traps;
+	int rave_equivalence; //visits at which a child's own mean and its all-moves-as-first mean weigh about the same, 0 disables RAVE
+	Reachability reachability; //sized to the board of the root state
+	DistanceField fruit_distances; //toward the root fruit, rebuilt on every new root and read by evaluation and rollouts
+
+	//exact search of nearly full boards, run by the main tree before any iteration
+	EndgameSolver endgame;
+	int endgame_cells; //free cells at or below which the solver runs, 0 disables it
+	EndgameStats endgame_stats;
+	static constexpr uint64_t ENDGAME_MAX_NODES = 1 << 16; //solver budget per move
+
+	//nodes discarded by update, released by the next search rather than by the caller of update
+	vector<ChildRange> garbage_ranges; //ranges without a live node
+	vector<uint32_t> garbage_subtrees; //nodes whose descendants are discarded
+	uint64_t num_pruned_nodes;
+
+#ifdef MCTS_STATS
+	//counters behind get_search_stats, atomic so lock-free workers can share them
+	struct SearchCounters {
+		atomic<uint64_t> selection_ns{0};
+		atomic<uint64_t> expansion_ns{0};
+		atomic<uint64_t> rollout_ns{0};
+		atomic<uint64_t> backpropagation_ns{0};
+		atomic<uint64_t> selections{0};
+		atomic<uint64_t> depth_sum{0};
+		atomic<uint32_t> max_depth{0};
+		atomic<uint64_t> terminal_hits{0};
+		atomic<uint64_t> nodes_created{0};
+		atomic<uint64_t> expansions{0};
+		atomic<uint64_t> expanded_children{0};
+	};
+	SearchCounters search_counters;
+
+	void record_selection(uint32_t leaf, const SnakeState& leaf_state); //depth and terminal state of a selected leaf
+#endif
+
+	//parallel search
+	ParallelMode parallel_mode;
+	unique_ptr<ThreadPool> pool;
+	vector<unique_ptr<MCTS>> root_trees; //extra trees searched by the other threads in root parallel mode
+	vector<mt19937> rollout_gens; //one generator per batch slot or worker thread in shared tree modes
+	vector<StateCache> state_caches; //the first serves the thread running the search, lock-free workers get one each
+	bool is_caching_states;
+
+	//statistics shared between transpositions, nullptr when disabled
+	//	children found in the table start with its visits and reward, every backpropagated node adds to its state's entry
+	unique_ptr<TranspositionTable> transpositions;
+	TTReplacement transposition_replacement; //handed on to the root parallel trees with the table size
+
+	//background search between moves
+	thread ponder_thread;
+	atomic<bool> is_stop_requested; //checked by the search drivers next to the deadline
+	SearchResult ponder_result;
+
+	Node& get_node(uint32_t index) { return (*nodes)[index]; }
+	const Node& get_node(uint32_t index) const { return (*nodes)[index]; }
+
 	//MCTS core functionality
-	void selection();
-	void expansion(shared_ptr<Node> node);
-	void rollout(shared_ptr<Node> node);
-	void backpropagation(shared_ptr<Node> node, double simulation_result);
+	//state holds the state of the node passed in or returned, selection and expansion replay every move they take on it
+	uint32_t selection(mt19937& rng, SnakeState& state, StateCache& cache, bool apply_virtual_loss = false);
+	void replay(uint32_t node, SnakeState& state, StateCache& cache); //state of node, from its deepest cached ancestor or the root
+	uint32_t expansion(uint32_t node, SnakeState& state, mt19937& rng, StateCache& cache); //returns the node to roll out, NO_NODE if there is none
+	uint32_t expand_chance(uint32_t node, SnakeState& state, mt19937& rng, StateCache& cache); //samples the fruit spawns of a chance node, returns the outcome to roll out
+	void warm_start(uint32_t node, uint32_t num_children); //children found in the transposition table start with its statistics, capped at the visits of node
+	int select_outcome(uint32_t node, ChildRange& children, int visits, mt19937& rng); //progressive widening, then a uniformly random published outcome
+	double rollout(uint32_t leaf, const SnakeState& leaf_state, mt19937& rng, MoveSet* played = nullptr); //proven reward of a decided leaf, a playout otherwise, its moves go to played unless it is null
+	void play_rollouts(const uint32_t* leaves, const SnakeState* leaf_states, int count, double* rewards, mt19937& rng, MoveSet* played = nullptr); //rewards of count leaves, NO_NODE entries are skipped, played holds one set per leaf unless it is null
+	void backpropagation(uint32_t node, double simulation_result, bool remove_virtual_loss = false);
+	void backpropagate_amaf(uint32_t leaf, const SnakeState& leaf_state, MoveSet& played, double simulation_reward); //adds the moves of the tree path to the playout's and updates the statistics of every node above leaf
+
+	//search drivers
+	SearchResult run_search(int iterations, Clock::time_point deadline);
+	void request_stop(bool stop); //sets the stop flag of this tree and the root parallel trees
+	bool is_stopped() const { return is_stop_requested.load(memory_order_relaxed); }
+
+	//each driver returns the number of iterations it completed before the iteration count or the deadline was reached
+	int search(int iterations, Clock::time_point deadline = Clock::time_point::max());
+	int search_batched(int iterations, Clock::time_point deadline);
+	int search_tree_parallel(int iterations, Clock::time_point deadline);
+	int search_lock_free(int iterations, Clock::time_point deadline);
+	uint32_t descend(mt19937& rng, SnakeState& state, StateCache& cache); //selection and expansion with virtual loss on the path, NO_NODE if nothing to roll out
+	void release_virtual_loss(uint32_t node);
+	void add_virtual_loss(uint32_t node, int amount); //adjusts the virtual loss stored for node in its parent
+	int best_action();
+	void reset_tree(const SnakeState& snake_state); //bulk release of every node, new root holds snake_state
+	void discard_path(uint32_t new_root); //queues everything above new_root and every subtree beside the path as garbage
+	void reclaim_memory(); //releases the garbage, prunes the least visited leaves near the cap, restarts from the root state as a last resort
+	void prune_if_full(); //prunes back to three quarters of the cap once an expansion may not fit, only between iterations without pending virtual loss
+	void prune_least_visited(uint32_t max_live); //collapses nodes with only leaf children, least visited first, until max_live nodes are left
+
+	//solver, decided nodes are backpropagated with their proven reward and never expanded or rolled out again
+	static constexpr double WIN_REWARD = 76.0; //reward of a full board
+	static constexpr double LOSS_REWARD = 0.0; //reward of a dead snake
+	Proof proven_result(uint32_t node) const; //value proven by the children of node
+	Proof proof_of(uint32_t node) const; //value of node as recorded in its parent, the root's from its children
+	void prove(uint32_t node, Proof proof); //records the value of node in its parent and passes completed proofs up to the root
+	bool is_solved() const { return proven_result(root) != PROOF_NONE; }
+	bool repeats_ancestor(uint32_t node) const; //the board of node was reached before on its path since the last fruit spawn
 
 	//MCTS additional functionality
-	bool is_max_length(Array snake_matrix);
-	bool is_terminal(Array snake_matrix);
-	double evaluate_state(Array start_state, Array end_state);
-	vector<int> get_possible_actions(Array snake_matrix);
+	double evaluate_state(const SnakeState& start_state, const SnakeState& end_state);
 
 public:
-	int run_MCTS(); //returns best action
-	void update(Array snake_matrix, int played_action); //update MCTS root
+	int run_MCTS(); //returns best action, -1 if the game is over
+	SearchResult run_MCTS(double time_budget, int iteration_budget = 0); //anytime search, stops after time_budget seconds or iteration_budget iterations, whichever comes first, a budget <= 0 is unlimited
+	void update(const SnakeState& snake_state, int played_action); //update MCTS root, keeps the subtree matching snake_state, including a sampled fruit spawn
+	void start_pondering(int iteration_budget = 0); //keeps searching the current root on a background thread, a budget <= 0 is unlimited
+	SearchResult collect(); //stops the background search, returns its best action and iteration count, 0 iterations if none was running
+	bool is_pondering() const { return ponder_thread.joinable(); }
+	void set_trap_pruning(TrapPruning mode, bool in_rollouts = false); //flood fill trap detection in expansion and optionally in every playout step
+	void set_rollout_batch(int batch_size); //rolls out up to MAX_PLAYOUT_BATCH leaves together per thread
+	void set_parallel(int num_threads, ParallelMode mode); //search with num_threads threads, deterministic for a given seed and thread count
+	void set_state_cache(bool is_enabled); //caches replayed states of shallow nodes, on by default
+	void set_rave(int equivalence); //blends all-moves-as-first means into UCT, the weight of a child's own mean reaches one half at equivalence visits, 0 disables it, off by default
+	void set_endgame_solver(int max_free_cells); //searches exactly at max_free_cells or fewer free cells and plays a proven win, DEFAULT_ENDGAME_CELLS by default, 0 disables it
+	void set_max_nodes(uint32_t max_nodes); //tree memory cap, least visited leaves are pruned near it, resets the tree
+	void set_max_bytes(size_t max_bytes) { set_max_nodes(uint32_t(min<size_t>(max_bytes / sizeof(Node), 0xfffffffe))); } //same cap in bytes of nodes
+	void set_transposition_table(size_t max_bytes, TTReplacement replacement = TT_REPLACE_LEAST_VISITED); //0 bytes disables it, root parallel trees get a table each
+	TTStats get_transposition_stats() const; //summed over the tables of every tree
+	PlayoutStats get_playout_stats() const; //rollouts since construction, summed over every tree
+	EndgameStats get_endgame_stats() const { return endgame_stats; } //endgame searches since construction
+	uint32_t get_num_nodes() const { return nodes->live(); }
+	size_t get_memory_usage() const { return nodes->reserved_bytes(); }
+	TreeStats get_tree_stats() const; //summed over every tree
+	Proof get_root_proof() const { return proven_result(root); } //a decided root ends every search at once
+	SearchStats get_search_stats() const; //summed over every tree, the deepest leaf of any tree
+
+	static constexpr uint32_t DEFAULT_MAX_NODES = 1 << 20; //about 170 MiB, nodes hold no board
+	static constexpr size_t DEFAULT_TT_BYTES = 16 << 20;
+	static constexpr int DEFAULT_ENDGAME_CELLS = 8;
+	static constexpr int DEFAULT_RAVE_EQUIVALENCE = 10; //equivalence for set_rave when RAVE is turned on, RAVE itself is off by default
 
 	//MCTS constructor default values
-	MCTS(Array snake_matrix = Array(), 
+	MCTS(const SnakeState& snake_state = SnakeState(), 
 		int max_iterations = 100,
 		int max_rollout_depth = 100,
 		int gen_seed = -1,
-		double exploration_constant = sqrt(2));
+		double exploration_constant = sqrt(2),
+		RolloutPolicy rollout_policy = ROLLOUT_UNIFORM);
+	~MCTS();
 };
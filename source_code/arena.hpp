@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+
+// Namespaces
+using namespace std;
+
+//fixed capacity arena addressed by 32-bit indices
+//	memory is reserved one chunk at a time as the arena grows, so the capacity is a cap and not an upfront cost
+//	allocate is thread safe and returns a contiguous range that never straddles two chunks
+//	elements are constructed by the caller and released in bulk by reset, without destructors
+//	ranges of up to MAX_RECYCLED_RANGE elements can also be released one by one, allocate reuses them before growing
+template<typename T>
+class Arena {
+	static_assert(is_trivially_destructible<T>::value, "arena elements are released in bulk without destructors");
+
+public:
+	static constexpr uint32_t NONE = 0xffffffff;
+	static constexpr uint32_t CHUNK_BITS = 10;
+	static constexpr uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+	static constexpr uint32_t CHUNK_MASK = CHUNK_SIZE - 1;
+	static constexpr uint32_t MAX_RECYCLED_RANGE = 16;
+
+private:
+	unique_ptr<atomic<T*>[]> chunks;
+	uint32_t num_chunks;
+	uint32_t max_size;
+	atomic<uint32_t> top; //first unallocated index
+	atomic<uint32_t> skipped; //chunk tails left empty because a range did not fit
+	uint32_t peak; //highest top before the last reset
+
+	//released ranges by size, filled between searches and handed out in order by allocate
+	//	allocate only advances free_taken, so the lists never change while threads allocate
+	vector<uint32_t> free_ranges[MAX_RECYCLED_RANGE + 1];
+	atomic<uint32_t> free_taken[MAX_RECYCLED_RANGE + 1];
+
+	void reserve_chunk(uint32_t chunk) {
+		if(chunks[chunk].load(memory_order_acquire)) {
+			return;
+		}
+
+		//two threads may race for a fresh chunk, the loser returns its memory
+		T* memory = static_cast<T*>(::operator new(sizeof(T) * CHUNK_SIZE));
+		T* expected = nullptr;
+		if(!chunks[chunk].compare_exchange_strong(expected, memory, memory_order_acq_rel)) {
+			::operator delete(memory);
+		}
+	}
+
+public:
+	T& operator[](uint32_t index) { return chunks[index >> CHUNK_BITS].load(memory_order_relaxed)[index & CHUNK_MASK]; }
+	const T& operator[](uint32_t index) const { return chunks[index >> CHUNK_BITS].load(memory_order_relaxed)[index & CHUNK_MASK]; }
+
+	uint32_t size() const { return top.load(memory_order_relaxed); } //elements below the bump pointer, released ones included
+	uint32_t capacity() const { return max_size; }
+	uint32_t high_water_mark() const { return max(peak, size()); } //most elements the arena ever spanned
+
+	//elements allocated and not released
+	uint32_t live() const {
+		uint32_t num_free = 0;
+		for(uint32_t count = 1; count <= MAX_RECYCLED_RANGE; count++) {
+			uint32_t taken = min<uint32_t>(free_taken[count].load(memory_order_relaxed), free_ranges[count].size());
+			num_free += (free_ranges[count].size() - taken) * count;
+		}
+		return size() - skipped.load(memory_order_relaxed) - num_free;
+	}
+
+	//first index of count contiguous elements, NONE once the arena is full
+	uint32_t allocate(uint32_t count) {
+		//a released range of the same size first
+		if(count <= MAX_RECYCLED_RANGE && free_taken[count].load(memory_order_relaxed) < free_ranges[count].size()) {
+			uint32_t taken = free_taken[count].fetch_add(1, memory_order_relaxed);
+			if(taken < free_ranges[count].size()) {
+				return free_ranges[count][taken];
+			}
+		}
+
+		uint32_t start = top.load(memory_order_relaxed);
+		uint32_t first;
+		do {
+			//skip the rest of the current chunk if the range does not fit into it
+			first = ((start & CHUNK_MASK) + count > CHUNK_SIZE) ? (start | CHUNK_MASK) + 1 : start;
+			if(first + count > max_size) {
+				return NONE;
+			}
+		} while(!top.compare_exchange_weak(start, first + count, memory_order_relaxed));
+		if(first != start) {
+			skipped.fetch_add(first - start, memory_order_relaxed);
+		}
+
+		reserve_chunk(first >> CHUNK_BITS);
+		return first;
+	}
+
+	//gives a range back for reuse, must not run concurrently with allocate
+	//	larger ranges stay allocated until the next reset
+	void release(uint32_t first, uint32_t count) {
+		if(count == 0 || count > MAX_RECYCLED_RANGE) {
+			return;
+		}
+
+		//drop the entries allocate has handed out already
+		vector<uint32_t>& ranges = free_ranges[count];
+		uint32_t taken = min<uint32_t>(free_taken[count].load(memory_order_relaxed), ranges.size());
+		ranges.erase(ranges.begin(), ranges.begin() + taken);
+		free_taken[count].store(0, memory_order_relaxed);
+		ranges.push_back(first);
+	}
+
+	//releases every element at once, reserved chunks are kept for reuse
+	void reset() {
+		peak = high_water_mark();
+		top.store(0, memory_order_relaxed);
+		skipped.store(0, memory_order_relaxed);
+		for(uint32_t count = 0; count <= MAX_RECYCLED_RANGE; count++) {
+			free_ranges[count].clear();
+			free_taken[count].store(0, memory_order_relaxed);
+		}
+	}
+
+	size_t reserved_bytes() const {
+		size_t bytes = 0;
+		for(uint32_t chunk = 0; chunk < num_chunks; chunk++) {
+			bytes += chunks[chunk].load(memory_order_relaxed) ? sizeof(T) * CHUNK_SIZE : 0;
+		}
+		return bytes;
+	}
+
+	Arena(uint32_t capacity)
+		:   chunks(new atomic<T*>[(capacity + CHUNK_SIZE - 1) / CHUNK_SIZE]),
+			num_chunks((capacity + CHUNK_SIZE - 1) / CHUNK_SIZE),
+			max_size(capacity),
+			top(0),
+			skipped(0),
+			peak(0) {
+		for(uint32_t count = 0; count <= MAX_RECYCLED_RANGE; count++) {
+			free_taken[count].store(0, memory_order_relaxed);
+		}
+		for(uint32_t chunk = 0; chunk < num_chunks; chunk++) {
+			chunks[chunk].store(nullptr, memory_order_relaxed);
+		}
+	}
+
+	~Arena() {
+		for(uint32_t chunk = 0; chunk < num_chunks; chunk++) {
+			::operator delete(chunks[chunk].load(memory_order_relaxed));
+		}
+	}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <atomic>
+
+// Namespaces
+using namespace std;
+
+//atomic<double> has no fetch_add before C++20
+inline void atomic_add(atomic<double>& value, double delta) {
+	double current = value.load(memory_order_relaxed);
+	while(!value.compare_exchange_weak(current, current + delta, memory_order_relaxed)) {}
+}
@@ -0,0 +1,112 @@
+#include <cstdint>
+#include <algorithm>
+
+#include <headers/snake_state.hpp>
+#include <headers/distance_field.hpp>
+
+// Namespaces
+using namespace std;
+
+DistanceField::DistanceField(int width, int height)
+	:   width(-1), height(-1), fruit(-1) {
+	resize(width, height);
+}
+
+void DistanceField::resize(int new_width, int new_height) {
+	if(new_width == width && new_height == height) {
+		return;
+	}
+
+	width = new_width;
+	height = new_height;
+	fruit = -1;
+	for(int y = 0; y < height; y++) {
+		for(int x = 0; x < width; x++) {
+			int cell = y * width + x;
+			neighbours[cell][0] = (y > 0) ? cell - width : -1;          //north
+			neighbours[cell][1] = (x < width - 1) ? cell + 1 : -1;      //east
+			neighbours[cell][2] = (y < height - 1) ? cell + width : -1; //south
+			neighbours[cell][3] = (x > 0) ? cell - 1 : -1;              //west
+		}
+	}
+}
+
+void DistanceField::build(const SnakeState& snake_state) {
+	resize(snake_state.width, snake_state.height);
+	fruit = snake_state.fruit;
+	int num_cells = width * height;
+	for(int cell = 0; cell < num_cells; cell++) {
+		distances[cell] = UNREACHABLE;
+	}
+	if(fruit == -1) {
+		return;
+	}
+
+	//time to live of every body cell, 0 for free cells
+	int16_t ttls[MAX_BOARD_CELLS] = {};
+	for(int ttl = 1; ttl <= snake_state.length; ttl++) {
+		ttls[snake_state.segment(ttl)] = ttl;
+	}
+
+	//first move at which the head can step onto each cell, one layer per move
+	//	a segment reached before it has left is crossed from the layer of its ttl on
+	int16_t arrivals[MAX_BOARD_CELLS];
+	bool is_waiting[MAX_BOARD_CELLS + 1] = {}; //segments reached early, by ttl
+	for(int cell = 0; cell < num_cells; cell++) {
+		arrivals[cell] = UNREACHABLE;
+	}
+	int16_t layers[2][MAX_BOARD_CELLS];
+	int layer_size = 1;
+	layers[0][0] = snake_state.head();
+	arrivals[snake_state.head()] = 0;
+	int last_waiting = 0;
+	for(int layer = 0; layer_size > 0 || layer < last_waiting; layer++) {
+		int16_t* current = layers[layer & 1];
+		int16_t* next = layers[(layer + 1) & 1];
+		if(layer > 0 && layer <= snake_state.length && is_waiting[layer]) {
+			current[layer_size++] = snake_state.segment(layer);
+		}
+
+		int next_size = 0;
+		for(int i = 0; i < layer_size; i++) {
+			for(int dir = 0; dir < 4; dir++) {
+				int cell = neighbours[current[i]][dir];
+				if(cell == -1 || arrivals[cell] != UNREACHABLE) {
+					continue;
+				}
+
+				arrivals[cell] = layer + 1;
+				if(ttls[cell] > layer + 1) {
+					is_waiting[ttls[cell]] = true;
+					last_waiting = max(last_waiting, int(ttls[cell]));
+				}
+				else {
+					next[next_size++] = cell;
+				}
+			}
+		}
+		layer_size = next_size;
+	}
+
+	//moves to the fruit through the cells the tail has left whenever the head gets there
+	//	a blocked cell still gets the distance of a head standing on it, the search does not pass it
+	int16_t* queue = layers[0];
+	int queue_begin = 0;
+	int queue_end = 0;
+	queue[queue_end++] = fruit;
+	distances[fruit] = 0;
+	while(queue_begin < queue_end) {
+		int from_cell = queue[queue_begin++];
+		for(int dir = 0; dir < 4; dir++) {
+			int cell = neighbours[from_cell][dir];
+			if(cell == -1 || distances[cell] != UNREACHABLE) {
+				continue;
+			}
+
+			distances[cell] = distances[from_cell] + 1;
+			if(ttls[cell] <= arrivals[cell]) {
+				queue[queue_end++] = cell;
+			}
+		}
+	}
+}
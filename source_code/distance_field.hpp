@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <headers/snake_state.hpp>
+
+// Namespaces
+using namespace std;
+
+//moves from every cell to the fruit around the body
+//	a body segment is an obstacle while it is still there when the head first gets next to it, the tail freeing cells is part of that timing
+//	so the field stays usable as the snake moves on and is only rebuilt when the fruit or the root changes
+class DistanceField {
+private:
+	int width;
+	int height;
+	int fruit; //cell the field leads to, -1 if there is none
+	int16_t neighbours[MAX_BOARD_CELLS][4]; //cell reached from a cell in each direction, -1 off the board
+	int16_t distances[MAX_BOARD_CELLS]; //moves to the fruit from a head on the cell, UNREACHABLE if every path is blocked
+
+	int manhattan(int from_cell, int to_cell) const { return abs(from_cell % width - to_cell % width) + abs(from_cell / width - to_cell / width); }
+
+public:
+	static constexpr int16_t UNREACHABLE = INT16_MAX;
+
+	void resize(int width, int height); //rebuilds the neighbour table, no-op if the size is unchanged
+	void build(const SnakeState& snake_state); //field toward the fruit of snake_state, its body as the obstacles
+
+	//moves from cell to target_cell, the field when it leads there and has a path, the Manhattan distance otherwise
+	int distance(int cell, int target_cell) const { return (target_cell == fruit && distances[cell] != UNREACHABLE) ? distances[cell] : manhattan(cell, target_cell); }
+
+	DistanceField(int width = 0, int height = 0);
+};
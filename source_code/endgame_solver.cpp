@@ -0,0 +1,203 @@
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include <headers/snake_state.hpp>
+#include <headers/playout.hpp>
+#include <headers/endgame_solver.hpp>
+
+// Namespaces
+using namespace std;
+
+EndgameSolver::EndgameSolver(int width, int height)
+	:   width(-1), height(-1), nodes(0), max_nodes(0) {
+	resize(width, height);
+}
+
+void EndgameSolver::resize(int new_width, int new_height) {
+	if(new_width == width && new_height == height) {
+		return;
+	}
+
+	width = new_width;
+	height = new_height;
+	reachability.resize(width, height);
+	for(int y = 0; y < height; y++) {
+		for(int x = 0; x < width; x++) {
+			int cell = y * width + x;
+			neighbours[cell][0] = (y > 0) ? cell - width : -1;          //north
+			neighbours[cell][1] = (x < width - 1) ? cell + 1 : -1;      //east
+			neighbours[cell][2] = (y < height - 1) ? cell + width : -1; //south
+			neighbours[cell][3] = (x > 0) ? cell - 1 : -1;              //west
+			cycle_next[cell] = -1;
+		}
+	}
+
+	int16_t order[MAX_BOARD_CELLS];
+	int cycle_length = hamiltonian_cycle(width, height, order);
+	for(int i = 0; i < cycle_length; i++) {
+		cycle_next[order[i]] = order[(i + 1) % cycle_length];
+	}
+
+	//entries of another board size never match, the memo is rebuilt by the next solve
+	memo.clear();
+}
+
+int EndgameSolver::lower_bound(const SnakeState& snake_state) const {
+	int fruits_left = snake_state.num_cells() - snake_state.length;
+	if(snake_state.fruit == -1) {
+		return fruits_left;
+	}
+	return distance(snake_state.head(), snake_state.fruit) + fruits_left - 1;
+}
+
+int EndgameSolver::aligned_links(const SnakeState& snake_state) const {
+	int aligned = 0;
+	for(int ttl = 1; ttl < snake_state.length; ttl++) {
+		aligned += cycle_next[snake_state.segment(ttl)] == snake_state.segment(ttl + 1);
+	}
+	return aligned;
+}
+
+int EndgameSolver::link_change(const SnakeState& parent, const SnakeState& child) const {
+	//the old head links to the new head, a step also drops the link behind the tail
+	int change = cycle_next[parent.head()] == child.head();
+	if(child.length == parent.length) {
+		change -= cycle_next[parent.tail()] == parent.segment(2);
+	}
+	return change;
+}
+
+Proof EndgameSolver::search(int ply, int depth, int aligned, int& action) {
+	nodes++;
+	const SnakeState& snake_state = states[ply];
+	int head_cell = snake_state.head();
+
+	//a body laid along the Hamiltonian cycle follows it and eats every fruit wherever it spawns
+	if(cycle_next[head_cell] != -1 && aligned == snake_state.length - 1) {
+		for(int dir = 0; dir < 4; dir++) {
+			if(neighbours[head_cell][dir] == cycle_next[head_cell]) {
+				action = dir;
+			}
+		}
+		return PROOF_WIN;
+	}
+
+	//a win only counts within the horizon it was proven in, so every move played shortens the proof and replanning cannot loop
+	MemoEntry& entry = memo[snake_state.hash & (MEMO_SIZE - 1)];
+	if(entry.hash == snake_state.hash) {
+		if(entry.proof == PROOF_LOSS || (entry.proof == PROOF_WIN && entry.depth <= depth)) {
+			action = entry.action;
+			return Proof(entry.proof);
+		}
+		if(entry.proof == PROOF_NONE && entry.depth >= depth) {
+			return PROOF_NONE;
+		}
+	}
+
+	//a full board cannot be reached within the horizon
+	if(depth == 0 || lower_bound(snake_state) > depth || nodes > max_nodes) {
+		return PROOF_NONE;
+	}
+
+	//moves into a wall, the body or a pocket too small to live in are lost, the move along the cycle is tried first, then toward the fruit
+	int moves = snake_state.safe_moves() & snake_state.forward_moves();
+	moves &= ~reachability.trapped_moves(snake_state, moves);
+	int ordered_moves[4];
+	int num_moves = 0;
+	for(; moves; moves &= moves - 1) {
+		ordered_moves[num_moves++] = lowest_bit(moves);
+	}
+	auto move_order = [&](int dir) {
+		int cell = neighbours[head_cell][dir];
+		return (cell == cycle_next[head_cell]) ? -1 : ((snake_state.fruit == -1) ? 0 : distance(cell, snake_state.fruit));
+	};
+	sort(ordered_moves, ordered_moves + num_moves, [&](int a, int b) { return move_order(a) < move_order(b); });
+
+	Proof proof = PROOF_LOSS;
+	int best_action = -1;
+	SnakeState& child_state = states[ply + 1];
+	for(int i = 0; i < num_moves && proof != PROOF_WIN; i++) {
+		int dir = ordered_moves[i];
+		child_state = snake_state;
+		MoveResult result = child_state.move(dir);
+		int child_aligned = aligned + link_change(snake_state, child_state);
+
+		int child_action;
+		Proof child_proof;
+		if(child_state.is_max_length()) {
+			child_proof = PROOF_WIN;
+		}
+		else if(result == MOVE_ATE) {
+			//every empty cell is a possible spawn, the move is decided only when all of them agree
+			bool is_won = true;
+			bool is_lost = true;
+			int empty_cells = child_state.num_cells() - child_state.length;
+			for(int index = 0; index < empty_cells && (is_won || is_lost); index++) {
+				child_state.place_fruit(-1);
+				child_state.place_fruit(child_state.nth_empty_cell(index));
+				Proof spawn_proof = search(ply + 1, depth - 1, child_aligned, child_action);
+				is_won &= spawn_proof == PROOF_WIN;
+				is_lost &= spawn_proof == PROOF_LOSS;
+			}
+			child_proof = is_won ? PROOF_WIN : (is_lost ? PROOF_LOSS : PROOF_NONE);
+		}
+		else {
+			child_proof = search(ply + 1, depth - 1, child_aligned, child_action);
+		}
+
+		if(child_proof == PROOF_WIN) {
+			proof = PROOF_WIN;
+			best_action = dir;
+		}
+		else if(child_proof == PROOF_NONE) {
+			proof = PROOF_NONE;
+		}
+	}
+
+	//an exhausted budget leaves the position unsearched, nothing is stored
+	if(nodes > max_nodes && proof == PROOF_NONE) {
+		return PROOF_NONE;
+	}
+
+	//proofs are kept over undecided entries, a longer win of the same position included
+	if(proof != PROOF_NONE || entry.proof == PROOF_NONE) {
+		entry = {snake_state.hash, int16_t(depth), uint8_t(proof), int8_t(best_action)};
+	}
+	action = best_action;
+	return proof;
+}
+
+EndgameResult EndgameSolver::solve(const SnakeState& snake_state, uint64_t max_nodes) {
+	resize(snake_state.width, snake_state.height);
+	if(memo.empty()) {
+		memo.assign(MEMO_SIZE, MemoEntry{0, -1, PROOF_NONE, -1});
+		states.resize(MAX_DEPTH + 2);
+	}
+
+	EndgameResult result;
+	if(snake_state.is_terminal() || snake_state.is_max_length()) {
+		result.proof = snake_state.is_max_length() ? PROOF_WIN : PROOF_LOSS;
+		return result;
+	}
+
+	//the horizon doubles from the fewest moves that could fill the board, a win proven by an earlier solve is replayed at its own horizon
+	states[0] = snake_state;
+	this->max_nodes = max_nodes;
+	nodes = 0;
+	int aligned = aligned_links(snake_state);
+	const MemoEntry& entry = memo[snake_state.hash & (MEMO_SIZE - 1)];
+	int first_depth = (entry.hash == snake_state.hash && entry.proof == PROOF_WIN) ? entry.depth : lower_bound(snake_state);
+	for(int depth = min(max(1, first_depth), MAX_DEPTH); ; depth = min(2 * depth, MAX_DEPTH)) {
+		result.proof = search(0, depth, aligned, result.action);
+		if(result.proof != PROOF_NONE || nodes > max_nodes || depth == MAX_DEPTH) {
+			break;
+		}
+	}
+
+	result.nodes = nodes;
+	if(result.proof != PROOF_WIN) {
+		result.action = -1;
+	}
+	return result;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <headers/snake_state.hpp>
+#include <headers/reachability.hpp>
+
+// Namespaces
+using namespace std;
+
+//game value proven by a solver, whatever the fruit spawns
+enum Proof {
+	PROOF_NONE, //not decided yet
+	PROOF_WIN,  //the board can be filled from here
+	PROOF_LOSS  //the snake dies whatever it does
+};
+
+//outcome of an endgame search
+struct EndgameResult {
+	Proof proof = PROOF_NONE;
+	int action = -1; //winning move of a proven win, -1 otherwise
+	uint64_t nodes = 0; //positions searched
+};
+
+//solver counters of a game
+struct EndgameStats {
+	uint64_t solves = 0;
+	uint64_t wins = 0; //searches that proved a win
+	uint64_t losses = 0; //searches that proved a loss
+	uint64_t nodes = 0;
+};
+
+//exact search of nearly full boards
+//	iterative deepening AND-OR search over SnakeState copies, the snake picks its move and every empty cell is a possible spawn
+//	a win is proven only when every spawn on the way fills the board, a loss only when every move dies
+//	the horizon doubles until the root is decided or the node budget runs out
+class EndgameSolver {
+private:
+	//a loss holds at any depth, a win from the depth it was proven within, an undecided entry up to the depth it was searched to
+	struct MemoEntry {
+		uint64_t hash;
+		int16_t depth;
+		uint8_t proof;
+		int8_t action;
+	};
+
+	static constexpr int MEMO_SIZE = 1 << 16; //entries, allocated by the first solve
+	static constexpr int MAX_DEPTH = 256; //moves, also the size of the state stack
+
+	int width;
+	int height;
+	int16_t neighbours[MAX_BOARD_CELLS][4]; //cell reached from a cell in each direction, -1 off the board
+	int16_t cycle_next[MAX_BOARD_CELLS]; //next cell along the Hamiltonian cycle, -1 if the board has none
+	Reachability reachability;
+
+	vector<MemoEntry> memo;
+	vector<SnakeState> states; //state of every ply, children are built in place of the next entry
+	uint64_t nodes;
+	uint64_t max_nodes;
+
+	int distance(int from_cell, int to_cell) const { return abs(from_cell % width - to_cell % width) + abs(from_cell / width - to_cell / width); }
+	int lower_bound(const SnakeState& snake_state) const; //moves needed to fill the board, the fruit is reached first and every later fruit takes a move
+	int aligned_links(const SnakeState& snake_state) const; //body links that follow the Hamiltonian cycle, the whole body along it always wins
+	int link_change(const SnakeState& parent, const SnakeState& child) const; //aligned links gained by the move from parent to child
+	Proof search(int ply, int depth, int aligned, int& action); //value of states[ply] within depth moves
+
+public:
+	void resize(int width, int height); //rebuilds the tables and clears the memo, no-op if the size is unchanged
+	EndgameResult solve(const SnakeState& snake_state, uint64_t max_nodes);
+
+	EndgameSolver(int width = 0, int height = 0);
+};
@@ -0,0 +1,342 @@
+#include <cstdint>
+#include <random>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <headers/snake_state.hpp>
+#include <headers/distance_field.hpp>
+#include <headers/playout.hpp>
+
+// Namespaces
+using namespace std;
+
+PlayoutEngine::PlayoutEngine(int width, int height)
+	:   width(-1), height(-1), has_cycle(false), is_pruning_traps(false), policy(ROLLOUT_UNIFORM), distance_field(nullptr) {
+	resize(width, height);
+}
+
+void PlayoutEngine::resize(int new_width, int new_height) {
+	if(new_width == width && new_height == height) {
+		return;
+	}
+
+	width = new_width;
+	height = new_height;
+	reachability.resize(width, height);
+	for(int y = 0; y < height; y++) {
+		for(int x = 0; x < width; x++) {
+			int cell = y * width + x;
+			cell_x[cell] = x;
+			cell_y[cell] = y;
+			neighbours[cell][0] = (y > 0) ? cell - width : -1;          //north
+			neighbours[cell][1] = (x < width - 1) ? cell + 1 : -1;      //east
+			neighbours[cell][2] = (y < height - 1) ? cell + width : -1; //south
+			neighbours[cell][3] = (x > 0) ? cell - 1 : -1;              //west
+
+			for(int dir = 0; dir < 4; dir++) {
+				lane_neighbours[dir][cell] = neighbours[cell][dir];
+			}
+		}
+	}
+	build_cycle();
+}
+
+int hamiltonian_cycle(int width, int height, int16_t* order) {
+	//a cycle needs an even side, walked as rows of length long_side and an even number of rows
+	if(width < 2 || height < 2 || (width % 2 != 0 && height % 2 != 0)) {
+		return 0;
+	}
+
+	bool is_row_major = height % 2 == 0;
+	int long_side = is_row_major ? width : height;
+	int num_rows = is_row_major ? height : width;
+	auto to_cell = [&](int along, int row) { return is_row_major ? row * width + along : along * width + row; };
+
+	//first row in full, the other rows serpentine without their first cell, the first column leads back to the start
+	int length = 0;
+	for(int along = 0; along < long_side; along++) {
+		order[length++] = to_cell(along, 0);
+	}
+	for(int row = 1; row < num_rows; row++) {
+		for(int i = 1; i < long_side; i++) {
+			order[length++] = to_cell((row % 2 == 1) ? long_side - i : i, row);
+		}
+	}
+	for(int row = num_rows - 1; row >= 1; row--) {
+		order[length++] = to_cell(0, row);
+	}
+
+	return length;
+}
+
+void PlayoutEngine::build_cycle() {
+	int16_t order[MAX_BOARD_CELLS];
+	int length = hamiltonian_cycle(width, height, order);
+	has_cycle = length > 0;
+
+	for(int i = 0; i < length; i++) {
+		int cell = order[i];
+		int next_cell = order[(i + 1) % length];
+		cycle_index[cell] = i;
+		for(int dir = 0; dir < 4; dir++) {
+			if(neighbours[cell][dir] == next_cell) {
+				cycle_direction[cell] = dir;
+			}
+		}
+	}
+}
+
+int PlayoutEngine::safe_moves(const SnakeState& snake_state) const {
+	//the tail cell is free since the tail moves away this turn
+	int head_cell = snake_state.head();
+	int tail_cell = snake_state.tail();
+	int moves = 0;
+	for(int dir = 0; dir < 4; dir++) {
+		int cell = neighbours[head_cell][dir];
+		bool is_safe = cell != -1 && (!snake_state.is_occupied(cell) || cell == tail_cell);
+		moves |= int(is_safe) << dir;
+	}
+
+	return moves;
+}
+
+int PlayoutEngine::legal_moves(const SnakeState& snake_state) const {
+	//dead snake has no moves left, its head may not be on the board
+	if(snake_state.is_dead || snake_state.length < 2) {
+		return 0;
+	}
+
+	return snake_state.legal_moves(safe_moves(snake_state));
+}
+
+int PlayoutEngine::choose_moves(const SnakeState& snake_state, int moves) const {
+	//the flood fill costs far more than a step, only pay for it when asked to
+	if(is_pruning_traps) {
+		int trapped = reachability.trapped_moves(snake_state, moves);
+		if(trapped != moves) {
+			moves &= ~trapped;
+		}
+	}
+
+	return moves;
+}
+
+int PlayoutEngine::random_move(int moves, mt19937& rng) const {
+	//pick a random set bit of the move mask
+	uniform_int_distribution<int> dis(0, bit_count(moves) - 1);
+	for(int skip = dis(rng); skip > 0; skip--) {
+		moves &= moves - 1;
+	}
+
+	return lowest_bit(moves);
+}
+
+int PlayoutEngine::closest_moves(const SnakeState& snake_state, int moves, int target_cell) const {
+	int head_cell = snake_state.head();
+	int best_distance = MAX_BOARD_CELLS;
+	int best_moves = 0;
+	for(int dir = 0; dir < 4; dir++) {
+		int cell = neighbours[head_cell][dir];
+		if(!(moves >> dir & 1) || cell == -1) {
+			continue;
+		}
+
+		int cell_distance = (distance_field != nullptr) ? distance_field->distance(cell, target_cell) : distance(cell, target_cell);
+		if(cell_distance < best_distance) {
+			best_distance = cell_distance;
+			best_moves = 0;
+		}
+		best_moves |= int(cell_distance == best_distance) << dir;
+	}
+
+	return best_moves;
+}
+
+int PlayoutEngine::cycle_moves(const SnakeState& snake_state, int moves) const {
+	//positions ahead of the head along the cycle
+	int num_cells = snake_state.num_cells();
+	int head_cell = snake_state.head();
+	auto ahead = [&](int cell) { return (cycle_index[cell] - cycle_index[head_cell] + num_cells) % num_cells; };
+	int tail_ahead = ahead(snake_state.tail());
+	int fruit_ahead = (snake_state.fruit != -1) ? ahead(snake_state.fruit) : num_cells;
+
+	//a long snake fills most of the cycle, it only survives by following it
+	int cycle_dir = cycle_direction[head_cell];
+	if(2 * snake_state.length >= num_cells) {
+		return moves & (1 << cycle_dir);
+	}
+
+	//shortcuts never jump past the fruit and leave room for the snake to grow before it reaches the tail
+	int best_ahead = 0;
+	int best_moves = moves & (1 << cycle_dir);
+	for(int dir = 0; dir < 4; dir++) {
+		int cell = neighbours[head_cell][dir];
+		if(!(moves >> dir & 1) || cell == -1) {
+			continue;
+		}
+
+		int cell_ahead = ahead(cell);
+		if(cell_ahead > best_ahead && cell_ahead <= fruit_ahead && cell_ahead + SHORTCUT_MARGIN < tail_ahead) {
+			best_ahead = cell_ahead;
+			best_moves = 1 << dir;
+		}
+	}
+
+	return best_moves;
+}
+
+int PlayoutEngine::choose_move(const SnakeState& snake_state, int moves, mt19937& rng) const {
+	//policies narrow the moves down, an empty preference falls back to a random legal move
+	int preferred = 0;
+	switch(policy) {
+		case ROLLOUT_UNIFORM:
+			break;
+		case ROLLOUT_GREEDY:
+			if(snake_state.fruit != -1 && int(rng() % 100) >= GREEDY_RANDOM_PERCENT) {
+				preferred = closest_moves(snake_state, moves, snake_state.fruit);
+			}
+			break;
+		case ROLLOUT_HAMILTONIAN:
+			if(has_cycle) {
+				preferred = cycle_moves(snake_state, moves);
+			}
+			break;
+		case ROLLOUT_TAIL_CHASE:
+			{
+				bool is_fruit_adjacent = snake_state.fruit != -1 && distance(snake_state.head(), snake_state.fruit) == 1;
+				preferred = closest_moves(snake_state, moves, is_fruit_adjacent ? snake_state.fruit : snake_state.tail());
+			}
+			break;
+	}
+
+	return random_move(preferred ? preferred : moves, rng);
+}
+
+int PlayoutEngine::play(SnakeState& snake_state, int max_depth, mt19937& rng, MoveSet* played) const {
+	int steps = 0;
+	while(steps < max_depth && !snake_state.is_terminal() && !snake_state.is_max_length() && snake_state.length >= 2) {
+		int moves = choose_moves(snake_state, legal_moves(snake_state));
+		int move_dir = choose_move(snake_state, moves, rng);
+		if(played != nullptr) {
+			played->add(snake_state.head(), move_dir);
+		}
+		snake_state.advance(move_dir, neighbours[snake_state.head()][move_dir]);
+		steps++;
+	}
+
+	return steps;
+}
+
+uint32_t PlayoutEngine::lane_blocked_moves(const SnakeState* states, const int32_t* lane_offsets, [[maybe_unused]] const int32_t* heads, [[maybe_unused]] const int32_t* tails, int num_lanes) const {
+	uint32_t blocked_lanes = 0;
+#ifdef __AVX2__
+	//a few lanes are cheaper to check one at a time than with eight lane gathers
+	if(num_lanes >= MIN_SIMD_LANES) {
+		//occupancy is read as 32-bit words, lane_offsets locate each game's bitboard relative to the first one
+		const int* occupancy_words = reinterpret_cast<const int*>(states[0].occupancy);
+		__m256i head_cells = _mm256_load_si256(reinterpret_cast<const __m256i*>(heads));
+		__m256i tail_cells = _mm256_load_si256(reinterpret_cast<const __m256i*>(tails));
+		__m256i offsets = _mm256_load_si256(reinterpret_cast<const __m256i*>(lane_offsets));
+
+		for(int dir = 0; dir < 4; dir++) {
+			//wall check, off board cells read cell 0 instead and are blocked regardless
+			__m256i cells = _mm256_i32gather_epi32(lane_neighbours[dir], head_cells, 4);
+			__m256i is_off_board = _mm256_cmpgt_epi32(_mm256_setzero_si256(), cells);
+			__m256i board_cells = _mm256_andnot_si256(is_off_board, cells);
+
+			//body check, the tail cell is free
+			__m256i words = _mm256_i32gather_epi32(occupancy_words, _mm256_add_epi32(offsets, _mm256_srli_epi32(board_cells, 5)), 4);
+			__m256i bits = _mm256_srlv_epi32(words, _mm256_and_si256(board_cells, _mm256_set1_epi32(31)));
+			__m256i is_occupied = _mm256_cmpeq_epi32(_mm256_and_si256(bits, _mm256_set1_epi32(1)), _mm256_set1_epi32(1));
+			__m256i is_tail = _mm256_cmpeq_epi32(cells, tail_cells);
+
+			__m256i is_blocked = _mm256_or_si256(is_off_board, _mm256_andnot_si256(is_tail, is_occupied));
+			blocked_lanes |= uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(is_blocked))) << (8 * dir);
+		}
+
+		return blocked_lanes;
+	}
+#endif
+
+	for(int lane = 0; lane < num_lanes; lane++) {
+		const SnakeState& snake_state = states[lane_offsets[lane] / LANE_STRIDE];
+		int blocked = ~safe_moves(snake_state);
+		for(int dir = 0; dir < 4; dir++) {
+			blocked_lanes |= uint32_t((blocked >> dir) & 1) << (8 * dir + lane);
+		}
+	}
+
+	return blocked_lanes;
+}
+
+uint64_t PlayoutEngine::play_batch(SnakeState* states, int count, int max_depth, mt19937& rng, MoveSet* played) const {
+	//hot per game values as lane arrays, running games are kept packed at the front
+	//	padding lanes look at cell 0 of the first game and never match a tail
+	alignas(32) int32_t heads[MAX_PLAYOUT_BATCH] = {};
+	alignas(32) int32_t tails[MAX_PLAYOUT_BATCH];
+	alignas(32) int32_t lane_offsets[MAX_PLAYOUT_BATCH] = {};
+	uint32_t blocked_lanes[MAX_PLAYOUT_BATCH / 8];
+	bool is_finished[MAX_PLAYOUT_BATCH];
+
+	int num_active = 0;
+	for(int lane = 0; lane < MAX_PLAYOUT_BATCH; lane++) {
+		tails[lane] = -2;
+	}
+	for(int game = 0; game < count; game++) {
+		const SnakeState& snake_state = states[game];
+		if(!snake_state.is_terminal() && !snake_state.is_max_length() && snake_state.length >= 2) {
+			heads[num_active] = snake_state.head();
+			tails[num_active] = snake_state.tail();
+			lane_offsets[num_active] = game * LANE_STRIDE;
+			num_active++;
+		}
+	}
+
+	uint64_t steps = 0;
+	for(int depth = 0; depth < max_depth && num_active > 0; depth++) {
+		for(int group = 0; group < num_active; group += 8) {
+			blocked_lanes[group / 8] = lane_blocked_moves(states, lane_offsets + group, heads + group, tails + group, min(8, num_active - group));
+		}
+
+		//apply one policy move per game, the same choice as play
+		for(int lane = 0; lane < num_active; lane++) {
+			//bits 0, 8, 16 and 24 of the shifted group mask are the lane's blocked directions
+			uint32_t lane_safe = ~blocked_lanes[lane / 8] >> (lane % 8) & 0x01010101;
+			int safe = (lane_safe | lane_safe >> 7 | lane_safe >> 14 | lane_safe >> 21) & 0xf;
+
+			int game = lane_offsets[lane] / LANE_STRIDE;
+			SnakeState& snake_state = states[game];
+			int moves = choose_moves(snake_state, snake_state.legal_moves(safe));
+			int move_dir = choose_move(snake_state, moves, rng);
+			if(played != nullptr) {
+				played[game].add(heads[lane], move_dir);
+			}
+
+			snake_state.advance(move_dir, neighbours[heads[lane]][move_dir]);
+			steps++;
+
+			is_finished[lane] = snake_state.is_terminal() || snake_state.is_max_length();
+			heads[lane] = snake_state.head();
+			tails[lane] = snake_state.tail();
+		}
+
+		//finished games leave the batch, the last running game takes their lane
+		for(int lane = num_active - 1; lane >= 0; lane--) {
+			if(!is_finished[lane]) {
+				continue;
+			}
+
+			num_active--;
+			heads[lane] = heads[num_active];
+			tails[lane] = tails[num_active];
+			lane_offsets[lane] = lane_offsets[num_active];
+			is_finished[lane] = is_finished[num_active];
+			heads[num_active] = 0;
+			tails[num_active] = -2;
+			lane_offsets[num_active] = 0;
+		}
+	}
+
+	return steps;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+
+#include <headers/snake_state.hpp>
+#include <headers/reachability.hpp>
+#include <headers/distance_field.hpp>
+
+// Namespaces
+using namespace std;
+
+constexpr int MAX_PLAYOUT_BATCH = 16; //games advanced together by play_batch, two AVX2 vectors of eight lanes
+
+//move choice inside a playout, every policy only picks among the legal moves
+enum RolloutPolicy {
+	ROLLOUT_UNIFORM,     //uniformly random legal move
+	ROLLOUT_GREEDY,      //epsilon-greedy, moves closer to the fruit unless a random move is drawn
+	ROLLOUT_HAMILTONIAN, //follows a Hamiltonian cycle of the board, shortcuts toward the fruit while the snake is short
+	ROLLOUT_TAIL_CHASE   //eats an adjacent fruit, otherwise moves closest to the tail to stay alive
+};
+
+//cells of a Hamiltonian cycle of the board in order, returns the cycle length, 0 if the board has none
+//	only boards with an even side have one
+int hamiltonian_cycle(int width, int height, int16_t* order);
+
+//directions played from every cell, four bits per cell, collected for all-moves-as-first statistics
+struct MoveSet {
+	uint64_t bits[MAX_BOARD_CELLS / 16];
+
+	void clear() { for(uint64_t& word : bits) word = 0; }
+	void add(int cell, int dir) { bits[cell >> 4] |= uint64_t(1) << ((cell & 15) * 4 + dir); }
+	int moves_from(int cell) const { return bits[cell >> 4] >> ((cell & 15) * 4) & 0xf; }
+};
+
+//playout counters of a search
+struct PlayoutStats {
+	uint64_t playouts = 0;
+	uint64_t steps = 0; //moves played inside playouts
+};
+
+//policy playouts advanced in place on one state
+//	board geometry is precomputed per board size, a step is a table lookup, a mask and one move
+class PlayoutEngine {
+private:
+	int width;
+	int height;
+	int16_t neighbours[MAX_BOARD_CELLS][4]; //cell reached from a cell in each direction, -1 off the board
+	int32_t lane_neighbours[4][MAX_BOARD_CELLS]; //same table direction major, gathered for eight heads at once
+
+	uint8_t cell_x[MAX_BOARD_CELLS];
+	uint8_t cell_y[MAX_BOARD_CELLS];
+
+	//Hamiltonian cycle, only boards with an even side have one
+	bool has_cycle;
+	int16_t cycle_index[MAX_BOARD_CELLS]; //position of a cell along the cycle
+	int8_t cycle_direction[MAX_BOARD_CELLS]; //direction to the next cell of the cycle
+
+	Reachability reachability;
+	bool is_pruning_traps; //playouts avoid moves into pockets when another move is left
+	RolloutPolicy policy;
+	const DistanceField* distance_field; //moves to the fruit around the body, Manhattan distance when null
+
+	static constexpr int GREEDY_RANDOM_PERCENT = 20; //share of random moves of the greedy policy
+	static constexpr int SHORTCUT_MARGIN = 3; //free cycle cells a Hamiltonian shortcut keeps in front of the tail
+
+	void build_cycle();
+	int choose_moves(const SnakeState& snake_state, int moves) const; //legal moves after trap pruning
+	int choose_move(const SnakeState& snake_state, int moves, mt19937& rng) const; //direction picked by the policy among non-empty moves
+	int random_move(int moves, mt19937& rng) const; //uniformly random set bit of moves
+	int distance(int from_cell, int to_cell) const { return abs(cell_x[from_cell] - cell_x[to_cell]) + abs(cell_y[from_cell] - cell_y[to_cell]); }
+	int closest_moves(const SnakeState& snake_state, int moves, int target_cell) const; //moves whose cell is nearest to target_cell
+	int cycle_moves(const SnakeState& snake_state, int moves) const; //move along the cycle, or a shortcut that skips no fruit and keeps ahead of the tail
+
+	static constexpr int LANE_STRIDE = sizeof(SnakeState) / sizeof(int32_t); //distance between the bitboards of two batched games in 32-bit words
+	static constexpr int MIN_SIMD_LANES = 4; //running games below which a lane group is checked one game at a time
+
+	int safe_moves(const SnakeState& snake_state) const; //SnakeState::safe_moves from the neighbour table
+	uint32_t lane_blocked_moves(const SnakeState* states, const int32_t* lane_offsets, const int32_t* heads, const int32_t* tails, int num_lanes) const; //bit 8 * d + lane set when direction d of a lane is blocked, up to eight lanes
+
+public:
+	void resize(int width, int height); //rebuilds the tables, no-op if the size is unchanged
+	void set_trap_pruning(bool is_pruning) { is_pruning_traps = is_pruning; }
+	void set_policy(RolloutPolicy rollout_policy) { policy = rollout_policy; }
+	void set_distance_field(const DistanceField* field) { distance_field = field; } //must outlive the engine's playouts
+
+	int legal_moves(const SnakeState& snake_state) const; //SnakeState::legal_moves from the neighbour table
+
+	//plays up to max_depth policy moves, returns the number played
+	//	every move is added to played unless it is null
+	int play(SnakeState& snake_state, int max_depth, mt19937& rng, MoveSet* played = nullptr) const;
+
+	//plays count <= MAX_PLAYOUT_BATCH games in lockstep, returns the moves played over every game
+	//	walls and bodies of eight games are checked per instruction with AVX2, moves are applied game by game
+	//	played holds one set per game unless it is null
+	uint64_t play_batch(SnakeState* states, int count, int max_depth, mt19937& rng, MoveSet* played = nullptr) const;
+
+	PlayoutEngine(int width = 0, int height = 0);
+};
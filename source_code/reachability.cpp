@@ -0,0 +1,117 @@
+#include <cstdint>
+#include <cstring>
+
+#include <headers/snake_state.hpp>
+#include <headers/reachability.hpp>
+
+// Namespaces
+using namespace std;
+
+Reachability::Reachability(int width, int height)
+	:   width(-1), height(-1) {
+	resize(width, height);
+}
+
+void Reachability::resize(int new_width, int new_height) {
+	if(new_width == width && new_height == height) {
+		return;
+	}
+
+	width = new_width;
+	height = new_height;
+	num_words = (width * height + 63) / 64;
+	memset(board, 0, sizeof(board));
+	memset(not_first_column, 0, sizeof(not_first_column));
+	memset(not_last_column, 0, sizeof(not_last_column));
+	for(int cell = 0; cell < width * height; cell++) {
+		uint64_t bit = uint64_t(1) << (cell & 63);
+		board[cell >> 6] |= bit;
+		if(cell % width != 0) {
+			not_first_column[cell >> 6] |= bit;
+		}
+		if(cell % width != width - 1) {
+			not_last_column[cell >> 6] |= bit;
+		}
+	}
+}
+
+void Reachability::spread(const uint64_t* reach, uint64_t* spread_reach) const {
+	//cells are row major, east and west are shifts by one, north and south shifts by the width
+	for(int word = 0; word < num_words; word++) {
+		uint64_t previous = (word > 0) ? reach[word - 1] : 0;
+		uint64_t next = (word + 1 < num_words) ? reach[word + 1] : 0;
+
+		uint64_t east = ((reach[word] << 1) | (previous >> 63)) & not_first_column[word];
+		uint64_t west = ((reach[word] >> 1) | (next << 63)) & not_last_column[word];
+		uint64_t south = (reach[word] << width) | (previous >> (64 - width));
+		uint64_t north = (reach[word] >> width) | (next << (64 - width));
+
+		spread_reach[word] = (reach[word] | east | west | south | north) & board[word];
+	}
+}
+
+bool Reachability::is_trap(const SnakeState& snake_state, int move_dir) const {
+	if(snake_state.collides(move_dir)) {
+		return false;
+	}
+
+	int head_cell = snake_state.next_cell(snake_state.resolve_direction(move_dir));
+	bool is_eating = head_cell == snake_state.fruit;
+	int length = snake_state.length + is_eating;
+
+	//free space after the move, the tail vacates its cell unless the snake grows
+	uint64_t free_cells[BOARD_WORDS];
+	uint64_t vacated[BOARD_WORDS] = {};
+	uint64_t reach[BOARD_WORDS] = {};
+	uint64_t spread_reach[BOARD_WORDS];
+	for(int word = 0; word < num_words; word++) {
+		free_cells[word] = board[word] & ~snake_state.occupancy[word];
+	}
+	if(!is_eating) {
+		int tail_cell = snake_state.tail();
+		vacated[tail_cell >> 6] |= uint64_t(1) << (tail_cell & 63);
+		free_cells[tail_cell >> 6] |= uint64_t(1) << (tail_cell & 63);
+	}
+	reach[head_cell >> 6] |= uint64_t(1) << (head_cell & 63);
+
+	for(int moves = 1; moves <= length; moves++) {
+		//the segment the tail leaves on this move becomes free
+		int ttl = is_eating ? moves : moves + 1;
+		if(ttl <= snake_state.length) {
+			int cell = snake_state.segment(ttl);
+			vacated[cell >> 6] |= uint64_t(1) << (cell & 63);
+			free_cells[cell >> 6] |= uint64_t(1) << (cell & 63);
+		}
+
+		//one step of the fill, the area excludes the head cell
+		spread(reach, spread_reach);
+		int area = -1;
+		bool is_following_tail = false;
+		for(int word = 0; word < num_words; word++) {
+			reach[word] |= spread_reach[word] & free_cells[word];
+			area += bit_count(reach[word]);
+			is_following_tail |= (reach[word] & vacated[word]) != 0;
+		}
+
+		//room for the whole body or a path behind the tail is safe, fewer cells than moves made is a dead end
+		if(is_following_tail || area >= length) {
+			return false;
+		}
+		if(area < moves) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int Reachability::trapped_moves(const SnakeState& snake_state, int moves) const {
+	int trapped = 0;
+	for(int dir = 0; dir < 4; dir++) {
+		if((moves >> dir & 1) && is_trap(snake_state, dir)) {
+			trapped |= 1 << dir;
+		}
+	}
+
+	return trapped;
+}
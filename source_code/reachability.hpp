@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include <headers/snake_state.hpp>
+
+// Namespaces
+using namespace std;
+
+//detects moves into pockets the snake cannot survive in
+//	bitboard flood fill from the cell the head moves into, one neighbour step per move
+//	body segments join the free space once the tail has moved past them, so room that opens up in time counts
+class Reachability {
+private:
+	int width;
+	int height;
+	int num_words; //bitboard words covering the board
+	uint64_t board[BOARD_WORDS];            //cells on the board
+	uint64_t not_first_column[BOARD_WORDS]; //cells an east step can reach
+	uint64_t not_last_column[BOARD_WORDS];  //cells a west step can reach
+
+	void spread(const uint64_t* reach, uint64_t* spread_reach) const; //reach and its neighbours on the board
+
+public:
+	void resize(int width, int height); //rebuilds the masks, no-op if the size is unchanged
+
+	//true if moving in move_dir leaves the head in a region too small to live in
+	//	the region is large enough once it holds the whole body or reaches a cell the tail has vacated, then the snake can follow its tail
+	//	moves into a wall or the body are not traps, they are handled by the safe move filter
+	bool is_trap(const SnakeState& snake_state, int move_dir) const;
+	int trapped_moves(const SnakeState& snake_state, int moves) const; //subset of moves that are traps
+
+	Reachability(int width = 0, int height = 0);
+};
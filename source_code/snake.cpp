@@ -15,11 +15,14 @@
 #include <Godot/classes/label.hpp>
 #include <Godot/classes/check_button.hpp>
 #include <Godot/classes/line_edit.hpp>
+#include <Godot/classes/option_button.hpp>
 #include <Godot/classes/button.hpp>
 #include <chrono>
+#include <algorithm>
 
 // Jenova SDK
 #include <JenovaSDK.h>
+#include <headers/snake_state.hpp>
 #include <headers/snake_functions.hpp>
 #include <headers/MCTS.hpp>
 
@@ -31,6 +34,18 @@ using namespace jenova::sdk;
 JENOVA_SCRIPT_BEGIN
 
 void start_game(Caller* instance);
+void delete_MCTS(Node2D* self);
+SnakeState* get_snake_state(Node2D* self);
+void delete_snake_state(Node2D* self);
+void set_tile(TileMapLayer* map, const SnakeState& snake_state, int cell, int atlas_x);
+
+//atlas x of every tile, -1 clears a cell
+enum Tile {
+	TILE_BODY = 0,
+	TILE_FRUIT = 1,
+	TILE_EMPTY = 2,
+	TILE_HEAD = 3
+};
 
 // Called When Node Enters Scene Tree
 void OnAwake(Caller* instance)
@@ -41,7 +56,9 @@ void OnAwake(Caller* instance)
 // Called When Node Exits Scene Tree
 void OnDestroy(Caller* instance)
 {
-
+	Node2D* self = GetSelf<Node2D>(instance);
+	delete_MCTS(self);
+	delete_snake_state(self);
 }
 
 // Called When Node and All It's Children Entered Scene Tree
@@ -80,6 +97,7 @@ void OnProcess(Caller* instance, Variant* _delta) {
 		self->set_meta("is_game_started", false);
 		Timer* timer = GetNode<Timer>("game/Timer");
 		timer->stop();
+		delete_MCTS(self);
 		LineEdit* line_seed = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/seed");
 		CheckButton* seed_button = GetNode<CheckButton>("game/ui/MarginContainer/VBoxContainer/seed_button");
 		seed_button->set_deferred("disabled", false);
@@ -88,17 +106,14 @@ void OnProcess(Caller* instance, Variant* _delta) {
 		}
 
 		//clear visuals
-		Array snake_matrix = self->get_meta("snake_matrix");
-		TileMapLayer* map = GetNode<TileMapLayer>("game/map/TileMapLayer");
-		for(int y = 0; y < snake_matrix.size(); y++) {
-			Array row = snake_matrix[y];
-			for(int x = 0; x < row.size(); x++) {
-				int atlas_x = -1;
-
-				//update tile at x, y with correct atlas index
-				map->set_cell(Vector2(x - (row.size() / 2), y - (snake_matrix.size() / 2)), 0, Vector2(atlas_x, 0));
+		SnakeState* snake_state = get_snake_state(self);
+		if(snake_state) {
+			TileMapLayer* map = GetNode<TileMapLayer>("game/map/TileMapLayer");
+			for(int cell = 0; cell < snake_state->num_cells(); cell++) {
+				set_tile(map, *snake_state, cell, -1);
 			}
 		}
+		delete_snake_state(self);
 
 		CanvasLayer* game_over = GetNode<CanvasLayer>("game/game_over");
 		game_over->set_deferred("visible", false);
@@ -124,45 +139,54 @@ void start_game(Caller* instance) {
 	Timer* timer = GetNode<Timer>("game/Timer");
 	timer->call_deferred("start");
 
-	//create matrix to track snake positions
-	//	0: empty grid square:
-	//	-1: fruit
-	//	positive int: int counting down TTL
 	LineEdit* line_y = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/HBoxContainer4/y");
 	LineEdit* line_x = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/HBoxContainer3/x");
 	int grid_y = line_y->get_text().to_int();
 	int grid_x = line_x->get_text().to_int();
 
-	Array snake_matrix;
-	for(int y = 0; y < grid_y; y++) {
-		Array row;
-		row.resize(grid_x);
-		for(int x = 0; x < grid_x; x++) {
-			row[x] = 0;
+	//native game state has a fixed maximum board size
+	grid_y = std::max(2, std::min(grid_y, MAX_BOARD_SIDE));
+	grid_x = std::max(2, std::min(grid_x, MAX_BOARD_SIDE));
+	line_y->set_text(String::num_int64(grid_y));
+	line_x->set_text(String::num_int64(grid_x));
 
-			if(x == 1 && y == 1) {
-				row[x] = 2;
-			}
-			if(x == 0 && y == 1) {
-				row[x] = 1;
-			}
-		}
-		snake_matrix.append(row);
+	//seed is chosen before the first fruit spawn so a random seed can be replayed
+	CheckButton* seed_button = GetNode<CheckButton>("game/ui/MarginContainer/VBoxContainer/seed_button");
+	seed_button->set_deferred("disabled", true);
+	LineEdit* line_seed = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/seed");
+	int seed;
+	if(line_seed->get_text() == "") {
+		seed = random_device{}();
 	}
+	else {
+		seed = line_seed->get_text().to_int();
+	}
+	line_seed->set_text(String::num_uint64(seed));
 
-	//initialize head and tail
-	Array row = snake_matrix[1];
-	row[1] = 2; //head initial TTL
-	row[0] = 1; //tail initial TTL
-	snake_matrix[1] = row;
-
-	//spawn fruit
-	snake_matrix = spawn_fruit(deep_duplicate(snake_matrix));
+	//initialize head and tail, spawn fruit
+	//	the native state lives between ticks, every tick moves it once and redraws the cells the move changed
+	delete_snake_state(self);
+	SnakeState* snake_state_ptr = new SnakeState(SnakeState::new_game(grid_x, grid_y, seed));
+	const SnakeState& snake_state = *snake_state_ptr;
+	set_fruit_seed(snake_state.fruit_seed);
 
 	//set metadata
-	self->set_meta("snake_matrix", snake_matrix);
+	self->set_meta("snake_state", reinterpret_cast<uint64_t>(snake_state_ptr));
 	self->set_meta("move_dir", 1); //east
 
+	//draw the whole board once
+	TileMapLayer* map = GetNode<TileMapLayer>("game/map/TileMapLayer");
+	for(int cell = 0; cell < snake_state.num_cells(); cell++) {
+		set_tile(map, snake_state, cell, TILE_EMPTY);
+	}
+	for(int ttl = 1; ttl < snake_state.length; ttl++) {
+		set_tile(map, snake_state, snake_state.segment(ttl), TILE_BODY);
+	}
+	set_tile(map, snake_state, snake_state.head(), TILE_HEAD);
+	if(snake_state.fruit != -1) {
+		set_tile(map, snake_state, snake_state.fruit, TILE_FRUIT);
+	}
+
 	//initialize MCTS
 	CheckButton* MCTS_button = GetNode<CheckButton>("game/ui/MarginContainer/VBoxContainer/is_MCTS_playing");
 	bool is_MCTS_playing = MCTS_button->is_pressed();
@@ -171,21 +195,22 @@ void start_game(Caller* instance) {
 	LineEdit* line_depth = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/HBoxContainer/MCTS_depth");
 	int MCTS_iterations = line_iterations->get_text().to_int();
 	int MCTS_depth = line_depth->get_text().to_int();
-	
-	CheckButton* seed_button = GetNode<CheckButton>("game/ui/MarginContainer/VBoxContainer/seed_button");
-	seed_button->set_deferred("disabled", true);
-	LineEdit* line_seed = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/seed");
-	int seed;
-	if(line_seed->get_text() == "") {
-		seed = random_device{}();
-	}
-	else {
-		seed = line_seed->get_text().to_int();
-	}
-	line_seed->set_text(String::num_uint64(seed));
 
-	MCTS* MCTS_instance = new MCTS(snake_matrix, MCTS_iterations, MCTS_depth, seed);
+	//optional rollout policy selector next to the iterations field, items in RolloutPolicy order, uniform without it
+	//	hamiltonian and tail playouts survive whatever the move, the search can circle without eating, so the game only offers uniform and greedy
+	OptionButton* policy_button = Object::cast_to<OptionButton>(line_iterations->get_parent()->get_node_or_null(NodePath("MCTS_policy")));
+	int policy_index = policy_button ? policy_button->get_selected() : 0;
+	RolloutPolicy rollout_policy = (policy_index >= ROLLOUT_UNIFORM && policy_index <= ROLLOUT_GREEDY) ? RolloutPolicy(policy_index) : ROLLOUT_UNIFORM;
+
+	//search in the background until the first tick, ticks only collect the result
+	delete_MCTS(self);
+	MCTS* MCTS_instance = new MCTS(snake_state, MCTS_iterations, MCTS_depth, seed, sqrt(2), rollout_policy);
+	MCTS_instance->set_transposition_table(MCTS::DEFAULT_TT_BYTES);
+	if(is_MCTS_playing) {
+		MCTS_instance->start_pondering(MCTS_iterations);
+	}
 	self->set_meta("is_MCTS_playing", is_MCTS_playing);
+	self->set_meta("MCTS_iterations", MCTS_iterations);
 	self->set_meta("seed", seed);
 	self->set_meta("MCTS_instance", reinterpret_cast<uint64_t>(MCTS_instance));
 
@@ -198,32 +223,81 @@ void start_game(Caller* instance) {
 	self->set_meta("start_time", prev_frame_time);
 }
 
+//native state of the current game, nullptr before the first game
+SnakeState* get_snake_state(Node2D* self) {
+	Variant state_var = self->get_meta("snake_state", Variant());
+	if(state_var.get_type() == Variant::NIL) {
+		return nullptr;
+	}
+
+	return reinterpret_cast<SnakeState*>(static_cast<uint64_t>(state_var));
+}
+
+void delete_snake_state(Node2D* self) {
+	delete get_snake_state(self);
+	self->remove_meta("snake_state");
+}
+
+//tilemap is centered on the board, cells are row major
+void set_tile(TileMapLayer* map, const SnakeState& snake_state, int cell, int atlas_x) {
+	int x = cell % snake_state.width;
+	int y = cell / snake_state.width;
+	map->set_cell(Vector2(x - (snake_state.width / 2), y - (snake_state.height / 2)), 0, Vector2(atlas_x, 0));
+}
+
+//stops the background search and frees the MCTS of the current game
+void delete_MCTS(Node2D* self) {
+	Variant mcts_var = self->get_meta("MCTS_instance", Variant());
+	if(mcts_var.get_type() != Variant::NIL) {
+		delete reinterpret_cast<MCTS*>(static_cast<uint64_t>(mcts_var));
+	}
+	self->remove_meta("MCTS_instance");
+}
+
 void on_timer_timeout(Node2D* self) {
 	//get player input
-	Array snake_matrix = self->get_meta("snake_matrix");
+	SnakeState* snake_state = get_snake_state(self);
+	if(!snake_state) {
+		return;
+	}
 	int move_dir = self->get_meta("move_dir");
 
 	//is MCTS playing?
 	bool is_MCTS_playing = self->get_meta("is_MCTS_playing");
-	Variant mcts_var = self->get_meta("MCTS_instance");
+	Variant mcts_var = self->get_meta("MCTS_instance", Variant());
 	MCTS* MCTS_instance = nullptr;
 	if(mcts_var.get_type() != Variant::NIL) {
 		MCTS_instance = reinterpret_cast<MCTS*>(static_cast<uint64_t>(mcts_var));
 	}
 
-	//run MCTS
+	//collect the search that ran in the background since the last move, it stops early once the iteration box is reached
+	//	0 iterations searches for the whole tick
+	//	a decided root or a solved endgame returns without iterations, only a game that never pondered searches here
+	int MCTS_iterations = self->get_meta("MCTS_iterations");
 	if(is_MCTS_playing && MCTS_instance) {
-		move_dir = MCTS_instance->run_MCTS();
+		bool was_pondering = MCTS_instance->is_pondering();
+		SearchResult search_result = MCTS_instance->collect();
+		if(!was_pondering) {
+			Timer* timer = GetNode<Timer>("game/Timer");
+			search_result = MCTS_instance->run_MCTS(0.8 * timer->get_wait_time(), MCTS_iterations);
+		}
+		move_dir = search_result.action;
+		self->set_meta("MCTS_searched_iterations", search_result.iterations);
+		if(move_dir == -1) {
+			UtilityFunctions::print("MCTS REACHED END OF GAME");
+		}
 	}
 
-	//update snake matrix based on input
-	snake_matrix = self->get_meta("snake_matrix");
-	snake_matrix = move_snake(deep_duplicate(snake_matrix), move_dir);
-	self->set_meta("snake_matrix", snake_matrix);
+	//play the move on the native state, only the old head, the old tail, the new head and the fruit can change
+	int old_head = snake_state->head();
+	int old_tail = snake_state->tail();
+	MoveResult move_result = snake_state->move(move_dir);
+	set_fruit_seed(snake_state->fruit_seed);
 
-	//update MCTS
+	//update MCTS, then keep searching from the new root until the next tick
 	if(is_MCTS_playing && MCTS_instance) {
-		MCTS_instance->update(deep_duplicate(snake_matrix), move_dir);
+		MCTS_instance->update(*snake_state, move_dir);
+		MCTS_instance->start_pondering(MCTS_iterations);
 	}
 
 	//update frame counter
@@ -244,119 +318,62 @@ void on_timer_timeout(Node2D* self) {
 	self->set_meta("prev_frame_time", curr_frame_time);
 	self->set_meta("avg_frame_time", avg_frame_time);
 
+#ifdef MCTS_STATS
+	//optional search profile next to the frame time, share of search time per phase and mean tree depth since the game started
+	LineEdit* search_stats_field = Object::cast_to<LineEdit>(frame_time->get_parent()->get_node_or_null(NodePath("search_stats")));
+	if(search_stats_field && is_MCTS_playing && MCTS_instance) {
+		SearchStats search_stats = MCTS_instance->get_search_stats();
+		double total_ns = max<uint64_t>(1, search_stats.selection_ns + search_stats.expansion_ns + search_stats.rollout_ns + search_stats.backpropagation_ns);
+		search_stats_field->set_text(
+			"sel " + String::num_uint64(100 * search_stats.selection_ns / total_ns) +
+			"% exp " + String::num_uint64(100 * search_stats.expansion_ns / total_ns) +
+			"% roll " + String::num_uint64(100 * search_stats.rollout_ns / total_ns) +
+			"% back " + String::num_uint64(100 * search_stats.backpropagation_ns / total_ns) +
+			"% depth " + String::num(search_stats.mean_depth(), 1));
+	}
+#endif
+
 	//update total runtime
 	int start_time = self->get_meta("start_time");
 	LineEdit* total_time = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/HBoxContainer8/total_time");
 	total_time->set_text(String::num_uint64((curr_frame_time - start_time) / 1000) + "." + String::num_uint64((curr_frame_time - start_time) % 1000));
 
-	//find snake length
-	double snake_length = 1;
-	for(int y = 0; y < snake_matrix.size(); y++) {
-		Array row = snake_matrix[y];
-		for(int x = 0; x < row.size(); x++) {
-			int cell_value = row[x];
-
-			if(cell_value > snake_length) {
-				snake_length = cell_value;
-			}
-		}
-	}
-
-	//check if game is over
-	bool is_game_won = true;
-	int one_counter = 0;
-	for(int y = 0; y < snake_matrix.size(); y++) {
-		Array row = snake_matrix[y];
-		for(int x = 0; x < row.size(); x++) {
-			int cell_value = row[x];
-
-			if(cell_value == 0 || cell_value == -1) {
-				is_game_won = false;
-			}
-
-			//count number of snake segments labeled 1
-			if(cell_value == 1) {
-				one_counter++;
-
-				//more than one segment labeled 1, state is terminal
-				if(one_counter > 1) {
-					break;
-				}
-			}
-		}
-
-		if(one_counter > 1) {
-			break;
-		}
-	}
-
 	//game lost
 	CanvasLayer* game_over = GetNode<CanvasLayer>("game/game_over");
 	Label* label = GetNode<Label>("game/game_over/PanelContainer/Label");
 	Timer* timer = GetNode<Timer>("game/Timer");
 
-	if(one_counter > 1) {
+	if(snake_state->is_terminal()) {
 		label->set_text("Game Over!");
 		game_over->set_deferred("visible", true);
 		timer->stop();
+		delete_MCTS(self);
 		return ;
 	}
 	
 	//game won
-	else if(is_game_won) {
+	else if(snake_state->is_max_length()) {
 		label->set_text("Game Won!");
 		game_over->set_deferred("visible", true);
 		timer->stop();
+		delete_MCTS(self);
 	}
 
-	//update visuals using tilemaplayer
+	//update visuals using tilemaplayer, only the cells the move changed
+	//	the vacated tail is cleared first, the head may have moved into it
 	TileMapLayer* map = GetNode<TileMapLayer>("game/map/TileMapLayer");
-	for(int y = 0; y < snake_matrix.size(); y++) {
-		Array row = snake_matrix[y];
-		for(int x = 0; x < row.size(); x++) {
-			int cell_value = row[x];
-			int atlas_x;
-			
-			//snake head
-			if(cell_value == snake_length) {
-				atlas_x = 3;
-			}
-
-			//snake cell
-			else if(cell_value > 0) {
-				atlas_x = 0;
-			} 
-
-			//fruit cell
-			else if(cell_value == -1) {
-				atlas_x = 1;
-			} 
-
-
-			//empty cell
-			else {
-				atlas_x = 2;
-			}
-
-			//update tile at x, y with correct atlas index
-			Vector2 tile_coords = Vector2(x - (row.size() / 2), y - (snake_matrix.size() / 2));
-			map->set_cell(tile_coords, 0, Vector2(atlas_x, 0));
-
-			//code to change snake color of snake as it moves
-			//currently doesn't work as updating the color applies to the entire snake, not individual cells
-			/*if(cell_value > 1) {
-				TileData* tile = map->get_cell_tile_data(tile_coords);
-				double tile_saturation = (cell_value + (snake_matrix.size() * row.size()) - snake_length) / (snake_matrix.size() * row.size());
-				UtilityFunctions::print(tile_saturation);
-				//UtilityFunctions::print(snake_length);
-				tile->set_modulate(Color(1, tile_saturation, 1, 1));
-			}*/
-		}
+	if(move_result == MOVE_STEP) {
+		set_tile(map, *snake_state, old_tail, TILE_EMPTY);
+	}
+	set_tile(map, *snake_state, old_head, TILE_BODY);
+	set_tile(map, *snake_state, snake_state->head(), TILE_HEAD);
+	if(move_result == MOVE_ATE && snake_state->fruit != -1) {
+		set_tile(map, *snake_state, snake_state->fruit, TILE_FRUIT);
 	}
 
 	//update score
 	LineEdit* score = GetNode<LineEdit>("game/ui/MarginContainer/VBoxContainer/HBoxContainer7/score");
-	score->set_text(String::num_uint64(snake_length));
+	score->set_text(String::num_uint64(snake_state->length));
 }
 
 // End Jenova Script
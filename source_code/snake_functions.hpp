@@ -1,7 +1,6 @@
 #pragma once
 
-#include <Godot/variant/array.hpp>
+#include <cstdint>
 
-godot::Array deep_duplicate(const godot::Array& matrix);
-godot::Array spawn_fruit(godot::Array snake_matrix);
-godot::Array move_snake(godot::Array snake_matrix, int move_dir);
+uint32_t get_fruit_seed();
+void set_fruit_seed(uint32_t seed);
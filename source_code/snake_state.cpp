@@ -0,0 +1,336 @@
+#include <cstring>
+#include <random>
+
+#include <headers/snake_state.hpp>
+
+// Namespaces
+using namespace std;
+
+//splitmix64 step, a full period 64-bit generator with one word of state
+static uint64_t splitmix64(uint64_t& state) {
+	uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+//random keys of the state hash, generated from a fixed seed so hashes match between runs
+struct ZobristKeys {
+	uint64_t link[MAX_BOARD_CELLS][4]; //body segment on a cell, followed by the next segment in a direction
+	uint64_t head[MAX_BOARD_CELLS];
+	uint64_t fruit[MAX_BOARD_CELLS];
+	uint64_t dead;
+
+	ZobristKeys() {
+		uint64_t seed = 0x5eed5eed5eed5eedULL;
+		for(int cell = 0; cell < MAX_BOARD_CELLS; cell++) {
+			for(int dir = 0; dir < 4; dir++) {
+				link[cell][dir] = splitmix64(seed);
+			}
+			head[cell] = splitmix64(seed);
+			fruit[cell] = splitmix64(seed);
+		}
+		dead = splitmix64(seed);
+	}
+};
+
+static const ZobristKeys zobrist;
+
+SnakeState::SnakeState(int width, int height)
+	:   width(width), height(height) {
+	clear();
+}
+
+void SnakeState::clear() {
+	memset(occupancy, 0, sizeof(occupancy));
+	head_index = -1;
+	length = 0;
+	fruit = -1;
+	direction = 1; //east, matches the initial snake
+	is_dead = false;
+	fruit_seed = 0;
+	sim_rng = 0;
+	is_simulated = false;
+	hash = 0;
+}
+
+SnakeState SnakeState::new_game(int width, int height, uint32_t fruit_seed) {
+	SnakeState snake_state(width, height);
+
+	//initialize head and tail
+	snake_state.push_head(1 * width + 0); //tail initial TTL
+	snake_state.push_head(1 * width + 1); //head initial TTL
+
+	//spawn fruit
+	snake_state.fruit_seed = fruit_seed;
+	snake_state.spawn_fruit();
+
+	return snake_state;
+}
+
+void SnakeState::push_head(int cell) {
+	//the old head becomes a body segment linked to the new head
+	if(length > 0) {
+		int head_cell = head();
+		hash ^= zobrist.head[head_cell] ^ zobrist.link[head_cell][link_direction(head_cell, cell)];
+	}
+	hash ^= zobrist.head[cell];
+
+	head_index = (head_index + 1) & BODY_MASK;
+	body[head_index] = cell;
+	occupancy[cell >> 6] |= uint64_t(1) << (cell & 63);
+	length++;
+}
+
+int SnakeState::first_body_cell() const {
+	for(int word = 0; word < BOARD_WORDS; word++) {
+		if(occupancy[word]) {
+			return word * 64 + lowest_bit(occupancy[word]);
+		}
+	}
+
+	return -1;
+}
+
+int SnakeState::link_direction(int from_cell, int to_cell) const {
+	int delta = to_cell - from_cell;
+	if     (delta == -width) return 0; //north
+	else if(delta == 1)      return 1; //east
+	else if(delta == width)  return 2; //south
+	else                     return 3; //west
+}
+
+int SnakeState::resolve_direction(int move_dir) const {
+	//prevent snake from making 180 degree turn, move straight instead
+	if(move_dir == (direction + 2) % 4) {
+		return direction;
+	}
+
+	return move_dir;
+}
+
+int SnakeState::next_cell(int move_dir) const {
+	int head_cell = head();
+	int x = head_cell % width;
+	int y = head_cell / width;
+
+	if     (move_dir == 0) y -= 1; //move north
+	else if(move_dir == 1) x += 1; //move east
+	else if(move_dir == 2) y += 1; //move south
+	else if(move_dir == 3) x -= 1; //move west
+
+	//check head boundary collision
+	if(x < 0 || y < 0 || x >= width || y >= height) {
+		return -1;
+	}
+
+	return y * width + x;
+}
+
+bool SnakeState::collides(int move_dir) const {
+	int cell = next_cell(resolve_direction(move_dir));
+	if(cell == -1) {
+		return true;
+	}
+
+	//the tail moves away this turn, every other body cell is a collision
+	return is_occupied(cell) && cell != tail();
+}
+
+int SnakeState::safe_moves() const {
+	//the head cell is looked up once, each direction is a bounds check and a bit test
+	int head_cell = head();
+	int x = head_cell % width;
+	int y = head_cell / width;
+	int tail_cell = tail();
+
+	int cells[4] = {
+		(y > 0) ? head_cell - width : -1,          //north
+		(x < width - 1) ? head_cell + 1 : -1,      //east
+		(y < height - 1) ? head_cell + width : -1, //south
+		(x > 0) ? head_cell - 1 : -1               //west
+	};
+
+	int moves = 0;
+	for(int dir = 0; dir < 4; dir++) {
+		bool is_safe = cells[dir] != -1 && (!is_occupied(cells[dir]) || cells[dir] == tail_cell);
+		moves |= int(is_safe) << dir;
+	}
+
+	return moves;
+}
+
+//moves MCTS and the playouts consider
+//	a dead snake has none, the 180 degree turn is never included
+//	moves into death are only offered when nothing else is left or the next move can win
+int SnakeState::legal_moves(int safe_moves) const {
+	if(is_dead || length < 2) {
+		return 0;
+	}
+
+	//allow snake to win
+	if(length == num_cells() - 1) {
+		return forward_moves();
+	}
+
+	safe_moves &= forward_moves();
+	return safe_moves ? safe_moves : forward_moves();
+}
+
+MoveResult SnakeState::move(int move_dir) {
+	if(is_dead || length < 2) {
+		return MOVE_BLOCKED;
+	}
+
+	move_dir = resolve_direction(move_dir);
+	return advance(move_dir, next_cell(move_dir));
+}
+
+MoveResult SnakeState::advance(int move_dir, int cell) {
+	//the tail moves away this turn, every other body cell is a collision
+	if(cell == -1 || (is_occupied(cell) && cell != tail())) {
+		set_dead();
+		return MOVE_DIED;
+	}
+
+	direction = move_dir;
+
+	//check head fruit collision, snake grows by keeping its tail
+	if(cell == fruit) {
+		push_head(cell);
+		place_fruit(-1);
+		spawn_fruit();
+
+		return MOVE_ATE;
+	}
+
+	//release the tail before placing the head, the head may move into the old tail cell
+	int tail_cell = tail();
+	hash ^= zobrist.link[tail_cell][link_direction(tail_cell, segment(2))];
+	occupancy[tail_cell >> 6] &= ~(uint64_t(1) << (tail_cell & 63));
+	length--;
+	push_head(cell);
+
+	return MOVE_STEP;
+}
+
+void SnakeState::spawn_fruit() {
+	//count empty squares
+	int empty_squares = num_cells() - length - (fruit != -1);
+	if(empty_squares <= 0) {
+		return; //game won
+	}
+
+	//spawn fruit in random empty square
+	int index;
+	if(is_simulated) {
+		//splitmix64 step, mapped to the range without modulo bias
+		uint64_t z = splitmix64(sim_rng);
+		index = int(((z >> 32) * uint64_t(empty_squares)) >> 32);
+	}
+	else {
+		//same draw as the game, seeded games replay exactly
+		mt19937 gen(fruit_seed);
+		uniform_int_distribution<> dis(0, empty_squares - 1);
+		index = dis(gen);
+		fruit_seed = gen();
+	}
+
+	place_fruit(nth_empty_cell(index));
+}
+
+uint64_t SnakeState::fruit_hash(int cell) const {
+	uint64_t new_hash = hash;
+	if(fruit != -1) {
+		new_hash ^= zobrist.fruit[fruit];
+	}
+	if(cell != -1) {
+		new_hash ^= zobrist.fruit[cell];
+	}
+
+	return new_hash;
+}
+
+void SnakeState::place_fruit(int cell) {
+	if(fruit != -1) {
+		hash ^= zobrist.fruit[fruit];
+	}
+	fruit = cell;
+	if(fruit != -1) {
+		hash ^= zobrist.fruit[fruit];
+	}
+}
+
+void SnakeState::set_dead() {
+	if(!is_dead) {
+		is_dead = true;
+		hash ^= zobrist.dead;
+	}
+}
+
+uint64_t SnakeState::compute_hash() const {
+	uint64_t full_hash = 0;
+	for(int ttl = 1; ttl < length; ttl++) {
+		full_hash ^= zobrist.link[segment(ttl)][link_direction(segment(ttl), segment(ttl + 1))];
+	}
+	if(length > 0) {
+		full_hash ^= zobrist.head[head()];
+	}
+	if(fruit != -1) {
+		full_hash ^= zobrist.fruit[fruit];
+	}
+	if(is_dead) {
+		full_hash ^= zobrist.dead;
+	}
+
+	return full_hash;
+}
+
+void SnakeState::use_simulated_fruit(uint64_t seed) {
+	sim_rng = seed;
+	is_simulated = true;
+}
+
+int SnakeState::nth_empty_cell(int index) const {
+	int cells = num_cells();
+	for(int word = 0; word * 64 < cells; word++) {
+		//empty bits of this word, masked to the board and without the fruit
+		uint64_t empty = ~occupancy[word];
+		if(cells - word * 64 < 64) {
+			empty &= (uint64_t(1) << (cells - word * 64)) - 1;
+		}
+		if(fruit >> 6 == word) {
+			empty &= ~(uint64_t(1) << (fruit & 63));
+		}
+
+		//skip whole words until the selected square is inside this one
+		int count = bit_count(empty);
+		if(index >= count) {
+			index -= count;
+			continue;
+		}
+
+		for(; index > 0; index--) {
+			empty &= empty - 1;
+		}
+		return word * 64 + lowest_bit(empty);
+	}
+
+	return -1;
+}
+
+bool SnakeState::operator==(const SnakeState& other) const {
+	if(width != other.width || height != other.height || length != other.length ||
+	   fruit != other.fruit || is_dead != other.is_dead) {
+		return false;
+	}
+
+	//compare body tail to head, equal bodies imply equal occupancy
+	for(int ttl = 1; ttl <= length; ttl++) {
+		if(segment(ttl) != other.segment(ttl)) {
+			return false;
+		}
+	}
+
+	return true;
+}
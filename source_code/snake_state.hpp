@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//native board limits, the bitboard and body ring buffer are fixed width
+constexpr int MAX_BOARD_SIDE = 32;
+constexpr int MAX_BOARD_CELLS = MAX_BOARD_SIDE * MAX_BOARD_SIDE;
+constexpr int BOARD_WORDS = MAX_BOARD_CELLS / 64;
+constexpr int BODY_MASK = MAX_BOARD_CELLS - 1; //ring buffer index mask, MAX_BOARD_CELLS is a power of two
+
+//index of the lowest set bit, word must be non-zero
+inline int lowest_bit(uint64_t word) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return int(index);
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+//number of set bits
+inline int bit_count(uint64_t word) {
+#ifdef _MSC_VER
+	return int(__popcnt64(word));
+#else
+	return __builtin_popcountll(word);
+#endif
+}
+
+//result of a single snake move
+enum MoveResult {
+	MOVE_BLOCKED, //state is already terminal, nothing changed
+	MOVE_STEP,    //snake moved forward
+	MOVE_ATE,     //snake moved forward and ate the fruit
+	MOVE_DIED     //snake hit a wall or itself
+};
+
+//compact game state used by the simulator and MCTS
+//	cells are indexed row major: cell = y * width + x
+//	directions match the game's move_dir: 0 north, 1 east, 2 south, 3 west
+struct SnakeState {
+	int width;
+	int height;
+
+	uint64_t occupancy[BOARD_WORDS]; //one bit per cell covered by the snake body
+	uint16_t body[MAX_BOARD_CELLS];  //ring buffer of body cells, tail at head_index - length + 1
+	int head_index;                  //ring buffer position of the head
+	int length;
+
+	int fruit;           //cell index of the fruit, -1 if there is no fruit on the board
+	int direction;       //direction of the previous move
+	bool is_dead;        //snake collided, every body cell is considered a tail
+
+	//fruit spawns
+	//	live game: mt19937 reseeded from fruit_seed on every spawn, seeded games replay exactly
+	//	simulation: splitmix64 counter carried in the state, no reseeding and no scene tree access
+	uint32_t fruit_seed;
+	uint64_t sim_rng;
+	bool is_simulated;
+
+	//Zobrist hash of the body, head, fruit and death, updated incrementally by every change to them
+	//	each body segment hashes its cell together with the direction of the next segment, so the body order is part of the hash
+	//	the fruit generators are not hashed, states differing only in future spawns are transpositions
+	uint64_t hash;
+
+	SnakeState(int width = 0, int height = 0);
+
+	//board queries
+	int num_cells() const { return width * height; }
+	int head() const { return body[head_index]; }
+	int tail() const { return body[(head_index - length + 1) & BODY_MASK]; }
+	int segment(int ttl) const { return body[(head_index - length + ttl) & BODY_MASK]; } //ttl 1 is the tail, ttl length is the head
+	bool is_occupied(int cell) const { return (occupancy[cell >> 6] >> (cell & 63)) & 1; }
+	int first_body_cell() const; //lowest occupied cell in row major order
+	int link_direction(int from_cell, int to_cell) const; //direction from a body cell to the adjacent next segment
+
+	//game rules
+	int resolve_direction(int move_dir) const; //a 180 degree turn continues straight instead
+	int next_cell(int move_dir) const;         //cell the head would move into, -1 if off the board
+	bool collides(int move_dir) const;         //O(1), accounts for the tail vacating its cell this turn
+	int forward_moves() const { return 0xf & ~(1 << ((direction + 2) % 4)); } //every direction except the 180 degree turn, bit d for direction d
+	int safe_moves() const;                    //directions that hit no wall and no body segment other than the tail
+	int legal_moves() const { return (is_dead || length < 2) ? 0 : legal_moves(safe_moves()); }
+	int legal_moves(int safe_moves) const;     //legal move mask from a precomputed safe mask, see legal_moves in snake_state.cpp
+	bool is_terminal() const { return is_dead; }
+	bool is_max_length() const { return length == num_cells(); }
+	MoveResult move(int move_dir);
+	MoveResult advance(int move_dir, int cell); //move with a resolved direction into cell, its next_cell computed by the caller
+	void spawn_fruit();
+	void use_simulated_fruit(uint64_t seed); //switch fruit spawns to the simulation generator
+	int nth_empty_cell(int index) const;     //index-th empty cell in row major order, skips the fruit
+	void place_fruit(int cell);              //-1 removes the fruit
+	uint64_t fruit_hash(int cell) const;     //hash after place_fruit(cell), the state is left unchanged
+	void set_dead();
+	uint64_t compute_hash() const;           //full recomputation of hash, for verification
+
+	//setup
+	void clear();
+	void push_head(int cell);
+
+	static SnakeState new_game(int width, int height, uint32_t fruit_seed); //snake of length 2 heading east, fruit spawned
+
+	bool operator==(const SnakeState& other) const;
+	bool operator!=(const SnakeState& other) const { return !(*this == other); }
+};
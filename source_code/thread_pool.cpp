@@ -0,0 +1,88 @@
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+#include <headers/thread_pool.hpp>
+
+// Namespaces
+using namespace std;
+
+ThreadPool::ThreadPool(int num_threads)
+	:   job(nullptr), next_task(0), num_tasks(0), generation(0), active_workers(0), is_stopping(false) {
+	for(int i = 1; i < num_threads; i++) {
+		workers.emplace_back(&ThreadPool::worker_loop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> lock(pool_mutex);
+		is_stopping = true;
+	}
+	start_condition.notify_all();
+
+	for(thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run(int num_tasks, const function<void(int)>& task) {
+	//nothing to share, run inline
+	if(workers.empty() || num_tasks <= 1) {
+		for(int i = 0; i < num_tasks; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	//publish job and wake workers
+	{
+		lock_guard<mutex> lock(pool_mutex);
+		job = &task;
+		this->num_tasks = num_tasks;
+		next_task.store(0);
+		active_workers = workers.size();
+		generation++;
+	}
+	start_condition.notify_all();
+
+	//caller works through tasks alongside the workers
+	drain();
+
+	//wait until every worker is done with this job
+	unique_lock<mutex> lock(pool_mutex);
+	done_condition.wait(lock, [this] { return active_workers == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::drain() {
+	for(int task = next_task.fetch_add(1); task < num_tasks; task = next_task.fetch_add(1)) {
+		(*job)(task);
+	}
+}
+
+void ThreadPool::worker_loop() {
+	int seen_generation = 0;
+	while(true) {
+		{
+			unique_lock<mutex> lock(pool_mutex);
+			start_condition.wait(lock, [&] { return is_stopping || generation != seen_generation; });
+			if(is_stopping) {
+				return;
+			}
+			seen_generation = generation;
+		}
+
+		drain();
+
+		{
+			lock_guard<mutex> lock(pool_mutex);
+			if(--active_workers == 0) {
+				done_condition.notify_one();
+			}
+		}
+	}
+}
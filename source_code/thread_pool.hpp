@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+// Namespaces
+using namespace std;
+
+//persistent worker threads running a blocking parallel for
+//	the calling thread takes part in every run, so a pool of size 1 has no worker threads
+class ThreadPool {
+private:
+	vector<thread> workers;
+	mutex pool_mutex;
+	condition_variable start_condition;
+	condition_variable done_condition;
+
+	//current job, tasks are handed out through an atomic counter
+	const function<void(int)>* job;
+	atomic<int> next_task;
+	int num_tasks;
+	int generation; //incremented for every run, wakes the workers
+	int active_workers;
+	bool is_stopping;
+
+	void worker_loop();
+	void drain();
+
+public:
+	int size() const { return int(workers.size()) + 1; }
+	void run(int num_tasks, const function<void(int)>& task); //calls task(0..num_tasks-1), returns once all finished
+
+	ThreadPool(int num_threads = 1);
+	~ThreadPool();
+};
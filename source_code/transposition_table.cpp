@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <memory>
+#include <atomic>
+
+#include <headers/atomic_utils.hpp>
+#include <headers/transposition_table.hpp>
+
+// Namespaces
+using namespace std;
+
+TranspositionTable::TranspositionTable(size_t max_bytes, TTReplacement replacement)
+	:   replacement(replacement), lookups(0), hits(0), replacements(0) {
+	//largest power of two number of entries within the cap, at least one
+	uint64_t num_entries = 1;
+	while(num_entries * 2 * sizeof(Entry) <= max_bytes) {
+		num_entries *= 2;
+	}
+
+	entries.reset(new Entry[num_entries]);
+	mask = num_entries - 1;
+	clear();
+}
+
+void TranspositionTable::clear() {
+	for(uint64_t i = 0; i <= mask; i++) {
+		entries[i].key.store(0, memory_order_relaxed);
+		entries[i].visits.store(0, memory_order_relaxed);
+		entries[i].reward.store(0, memory_order_relaxed);
+	}
+	lookups.store(0, memory_order_relaxed);
+	hits.store(0, memory_order_relaxed);
+	replacements.store(0, memory_order_relaxed);
+}
+
+bool TranspositionTable::probe(uint64_t key, int& visits, double& reward) {
+	lookups.fetch_add(1, memory_order_relaxed);
+	Entry& entry = entries[key & mask];
+	if(entry.key.load(memory_order_relaxed) != key) {
+		return false;
+	}
+
+	hits.fetch_add(1, memory_order_relaxed);
+	visits = entry.visits.load(memory_order_relaxed);
+	reward = entry.reward.load(memory_order_relaxed);
+	return true;
+}
+
+void TranspositionTable::store(uint64_t key, double reward) {
+	Entry& entry = entries[key & mask];
+	uint64_t resident_key = entry.key.load(memory_order_relaxed);
+	if(resident_key == key) {
+		entry.visits.fetch_add(1, memory_order_relaxed);
+		atomic_add(entry.reward, reward);
+		return;
+	}
+
+	//well visited states survive a few collisions, the mean reward is kept while aging
+	if(resident_key != 0 && replacement == TT_REPLACE_LEAST_VISITED) {
+		int visits = entry.visits.load(memory_order_relaxed);
+		if(visits > 1) {
+			entry.visits.store(visits / 2, memory_order_relaxed);
+			entry.reward.store(entry.reward.load(memory_order_relaxed) * (visits / 2) / visits, memory_order_relaxed);
+			return;
+		}
+	}
+
+	replacements.fetch_add(resident_key != 0, memory_order_relaxed);
+	entry.key.store(key, memory_order_relaxed);
+	entry.visits.store(1, memory_order_relaxed);
+	entry.reward.store(reward, memory_order_relaxed);
+}
+
+TTStats TranspositionTable::get_stats() const {
+	TTStats stats;
+	stats.lookups = lookups.load(memory_order_relaxed);
+	stats.hits = hits.load(memory_order_relaxed);
+	stats.replacements = replacements.load(memory_order_relaxed);
+	stats.bytes = (mask + 1) * sizeof(Entry);
+
+	return stats;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <atomic>
+
+// Namespaces
+using namespace std;
+
+//what happens when a state misses the table and its slot holds another state
+enum TTReplacement {
+	TT_REPLACE_ALWAYS,       //the newest state takes the slot
+	TT_REPLACE_LEAST_VISITED //the resident entry is aged by halving its statistics, it is replaced once it has at most one visit
+};
+
+//table activity, summed over every table of a search
+struct TTStats {
+	uint64_t lookups = 0;
+	uint64_t hits = 0;
+	uint64_t replacements = 0; //resident states evicted by another state
+	size_t bytes = 0;
+
+	double hit_rate() const { return lookups ? double(hits) / lookups : 0; }
+};
+
+//bounded table of search statistics per state hash, shared by every node that reaches the same state
+//	one entry per slot, the slot count is the largest power of two that fits the memory cap
+//	fields are relaxed atomics, a parallel search may read an entry in the middle of an update, which only skews a prior
+class TranspositionTable {
+private:
+	struct Entry {
+		atomic<uint64_t> key; //state hash, 0 for an empty slot
+		atomic<int> visits;
+		atomic<double> reward;
+	};
+
+	unique_ptr<Entry[]> entries;
+	uint64_t mask;
+	TTReplacement replacement;
+
+	atomic<uint64_t> lookups;
+	atomic<uint64_t> hits;
+	atomic<uint64_t> replacements;
+
+public:
+	bool probe(uint64_t key, int& visits, double& reward); //statistics of key, false if the table does not hold it
+	void store(uint64_t key, double reward);               //adds one visit with reward to key
+	void clear();
+	TTStats get_stats() const;
+
+	TranspositionTable(size_t max_bytes, TTReplacement replacement = TT_REPLACE_LEAST_VISITED);
+};